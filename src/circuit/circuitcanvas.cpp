@@ -1,8 +1,12 @@
 #include "circuitcanvas.h"
+#include "elementquery.h"
+#include "elementbatchitem.h"
 #include <QGraphicsScene>
 #include <QGraphicsRectItem>
 #include <QPen>
 #include <QBrush>
+#include <QPainter>
+#include <QSet>
 #include <cmath>
 
 CircuitCanvas::CircuitCanvas(QWidget *parent)
@@ -10,15 +14,29 @@ CircuitCanvas::CircuitCanvas(QWidget *parent)
     , scene(nullptr)
     , activeElementType(ElementType::Resistor)
     , hasActiveElement(false)
+    , nextElementId(1)
+    , released(false)
+    , highDensity(false)
+    , batch(nullptr)
+    , hoveredId(0)
+    , demotionPending(false)
+    , staticLayerActive(false)
 {
-    scene = new QGraphicsScene(this);
+    scene = new CircuitScene(this);
     scene->setSceneRect(-1000, -1000, 2000, 2000);
     setScene(scene);
     
+    connect(scene, &QGraphicsScene::sceneRectChanged, this, [this](const QRectF &rect) {
+        if (batch) {
+            batch->setBounds(rect);
+        }
+    });
+    connect(scene, &QGraphicsScene::selectionChanged, this, &CircuitCanvas::scheduleDemotion);
+    connect(this, &QGraphicsView::rubberBandChanged, this, &CircuitCanvas::trackRubberBand);
+    
     setDragMode(QGraphicsView::RubberBandDrag);
     setRenderHint(QPainter::Antialiasing);
-    
-    setupGrid();
+    setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
 }
 
 void CircuitCanvas::setActiveElementType(ElementType type)
@@ -35,9 +53,17 @@ void CircuitCanvas::clearCircuit()
         delete element;
     }
     elements.clear();
+    elementsById.clear();
+    hoveredId = 0;
+    scene->clearElements();
+    clearDiff();
     
+    // The scene deletes the batch item along with everything else
+    batch = nullptr;
     scene->clear();
-    setupGrid();
+    if (highDensity) {
+        createBatch();
+    }
     
     emit circuitChanged();
 }
@@ -46,22 +72,449 @@ void CircuitCanvas::mousePressEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton && hasActiveElement) {
         QPointF scenePos = mapToScene(event->pos());
-        QPointF gridPos = snapToGrid(scenePos);
-        
-        CircuitElement *element = new CircuitElement(activeElementType);
-        element->setPos(gridPos);
-        element->setFlag(QGraphicsItem::ItemIsMovable);
-        element->setFlag(QGraphicsItem::ItemIsSelectable);
-        
-        scene->addItem(element);
-        elements.append(element);
+        addElement(activeElementType, scenePos);
         
         hasActiveElement = false;
         setCursor(Qt::ArrowCursor);
         
         emit circuitChanged();
     } else {
+        // The element under the cursor needs an item to take the press
+        if (highDensity) {
+            if (quint64 id = elementAt(mapToScene(event->pos()))) {
+                promote(id);
+            }
+        }
+        
         QGraphicsView::mousePressEvent(event);
+        
+        if (event->button() == Qt::LeftButton && scene->mouseGrabberItem()
+            && !scene->selectedItems().isEmpty()) {
+            beginStaticLayer();
+        }
+    }
+}
+
+void CircuitCanvas::mouseMoveEvent(QMouseEvent *event)
+{
+    if (highDensity && event->buttons() == Qt::NoButton) {
+        quint64 id = elementAt(mapToScene(event->pos()));
+        if (id != hoveredId) {
+            hoveredId = id;
+            if (id) {
+                promote(id);
+            }
+            scheduleDemotion();
+        }
+    }
+    
+    QGraphicsView::mouseMoveEvent(event);
+}
+
+void CircuitCanvas::mouseReleaseEvent(QMouseEvent *event)
+{
+    QGraphicsView::mouseReleaseEvent(event);
+    
+    if (staticLayerActive && !scene->mouseGrabberItem()) {
+        endStaticLayer();
+    }
+}
+
+CircuitElement *CircuitCanvas::createItem(quint64 id, ElementType type, const QPointF &pos)
+{
+    CircuitElement *element = new CircuitElement(type);
+    element->setId(id);
+    element->setPos(pos);
+    element->setFlag(QGraphicsItem::ItemIsMovable);
+    element->setFlag(QGraphicsItem::ItemIsSelectable);
+    return element;
+}
+
+void CircuitCanvas::attachItem(CircuitElement *element)
+{
+    scene->addItem(element);
+    elements.append(element);
+    elementsById.insert(element->getId(), element);
+}
+
+// Repaints the symbol area around pos, for elements without an item
+void CircuitCanvas::updateRecordArea(const QPointF &pos)
+{
+    QRectF area = CircuitElement::symbolRect().translated(pos);
+    if (staticLayerActive) {
+        invalidateStaticLayer(area);
+    } else {
+        scene->update(area);
+    }
+}
+
+quint64 CircuitCanvas::addElement(ElementType type, const QPointF &pos)
+{
+    const quint64 id = nextElementId++;
+    
+    if (highDensity) {
+        ElementRecord record;
+        record.id = id;
+        record.type = type;
+        record.pos = CircuitScene::snapToGrid(pos);
+        record.label = CircuitElement::defaultLabel(type);
+        scene->insertRecord(record);
+        updateRecordArea(record.pos);
+        return id;
+    }
+    
+    CircuitElement *element = createItem(id, type, CircuitScene::snapToGrid(pos));
+    attachItem(element);
+    scene->elementAdded(element);
+    
+    if (staticLayerActive) {
+        invalidateStaticLayer(element->sceneBoundingRect());
+    }
+    
+    return id;
+}
+
+void CircuitCanvas::moveElement(quint64 id, const QPointF &pos)
+{
+    if (CircuitElement *element = elementsById.value(id)) {
+        element->setPos(pos);
+        return;
+    }
+    
+    ElementRecord record;
+    if (!scene->elementIndex().lookup(id, &record)) {
+        return;
+    }
+    
+    QPointF snapped = CircuitScene::snapToGrid(pos);
+    if (snapped != record.pos) {
+        scene->moveRecord(id, snapped);
+        updateRecordArea(record.pos);
+        updateRecordArea(snapped);
+    }
+}
+
+void CircuitCanvas::relabelElement(quint64 id, const QString &label)
+{
+    if (CircuitElement *element = elementsById.value(id)) {
+        element->setLabel(label);
+        element->update();
+        return;
+    }
+    
+    ElementRecord record;
+    if (scene->elementIndex().lookup(id, &record) && record.label != label) {
+        scene->relabelRecord(id, label);
+        updateRecordArea(record.pos);
+    }
+}
+
+// Adds many elements at once, with their labels, and reports a single
+// change. The scene grows to hold elements outside the default area.
+void CircuitCanvas::importElements(const QList<ElementRecord> &records)
+{
+    elements.reserve(elements.size() + records.size());
+    elementsById.reserve(elementsById.size() + records.size());
+    
+    QRectF area;
+    const QRectF symbol = CircuitElement::symbolRect();
+    
+    for (const ElementRecord &record : records) {
+        if (highDensity) {
+            ElementRecord placed = record;
+            placed.id = nextElementId++;
+            placed.pos = CircuitScene::snapToGrid(record.pos);
+            scene->insertRecord(placed);
+            area |= symbol.translated(placed.pos);
+            continue;
+        }
+        
+        CircuitElement *element = createItem(nextElementId++, record.type, CircuitScene::snapToGrid(record.pos));
+        element->setLabel(record.label);
+        attachItem(element);
+        scene->elementAdded(element);
+        area |= symbol.translated(element->pos());
+    }
+    
+    if (!area.isNull() && !scene->sceneRect().contains(area)) {
+        const qreal margin = GRID_SIZE * 10;
+        scene->setSceneRect(scene->sceneRect() | area.adjusted(-margin, -margin, margin, margin));
+    }
+    if (highDensity) {
+        scene->update(area);
+    }
+    emit circuitChanged();
+}
+
+// Brings the circuit to the state described by records in place. A record
+// with the id of an element of the same type updates it, any other record
+// is added, and elements without a record are removed; untouched elements
+// keep their ids, items and selection. Reports a single change.
+void CircuitCanvas::applyRecords(const QList<ElementRecord> &records)
+{
+    QSet<quint64> kept;
+    QList<ElementRecord> added;
+    ElementRecord current;
+    
+    for (const ElementRecord &record : records) {
+        if (!record.id || !scene->elementIndex().lookup(record.id, &current)
+            || current.type != record.type) {
+            added.append(record);
+            continue;
+        }
+        kept.insert(record.id);
+        if (record.pos != current.pos) {
+            moveElement(record.id, record.pos);
+        }
+        if (record.label != current.label) {
+            relabelElement(record.id, record.label);
+        }
+    }
+    
+    for (quint64 id : scene->elementIndex().allIds()) {
+        if (!kept.contains(id)) {
+            removeElement(id);
+        }
+    }
+    
+    importElements(added);
+}
+
+void CircuitCanvas::releaseItems()
+{
+    if (released) {
+        return;
+    }
+    
+    // Items leave without notifying the scene, its records stay as they are
+    for (auto element : elements) {
+        scene->removeItem(element);
+        delete element;
+    }
+    elements.clear();
+    elementsById.clear();
+    hoveredId = 0;
+    released = true;
+}
+
+void CircuitCanvas::restoreItems()
+{
+    if (!released) {
+        return;
+    }
+    
+    // The batch item draws straight from the scene's records
+    if (highDensity) {
+        released = false;
+        return;
+    }
+    
+    const CircuitSnapshot records = scene->snapshot();
+    elements.reserve(records.size());
+    elementsById.reserve(records.size());
+    
+    records.forEach([this](const ElementRecord &record) {
+        CircuitElement *element = createItem(record.id, record.type, record.pos);
+        element->setLabel(record.label);
+        attachItem(element);
+    });
+    released = false;
+}
+
+void CircuitCanvas::removeElement(quint64 id)
+{
+    if (hoveredId == id) {
+        hoveredId = 0;
+    }
+    
+    CircuitElement *element = elementsById.take(id);
+    if (!element) {
+        ElementRecord record;
+        if (scene->elementIndex().lookup(id, &record)) {
+            scene->removeRecord(id);
+            updateRecordArea(record.pos);
+        }
+        return;
+    }
+    
+    if (staticLayerActive) {
+        invalidateStaticLayer(element->sceneBoundingRect());
+    }
+    
+    elements.removeOne(element);
+    scene->elementRemoved(element);
+    scene->removeItem(element);
+    delete element;
+}
+
+QList<quint64> CircuitCanvas::findElements(const QString &query, QString *errorMessage) const
+{
+    ElementQuery parsed;
+    if (!ElementQuery::parse(query, &parsed, errorMessage)) {
+        return QList<quint64>();
+    }
+    
+    return parsed.run(scene->elementIndex());
+}
+
+void CircuitCanvas::selectElements(const QList<quint64> &ids)
+{
+    scene->clearSelection();
+    for (quint64 id : ids) {
+        if (CircuitElement *element = promote(id)) {
+            element->setSelected(true);
+        }
+    }
+}
+
+void CircuitCanvas::zoomToElements(const QList<quint64> &ids)
+{
+    QRectF area;
+    const QRectF symbol = CircuitElement::symbolRect();
+    ElementRecord record;
+    for (quint64 id : ids) {
+        if (scene->elementIndex().lookup(id, &record)) {
+            area |= symbol.translated(record.pos);
+        }
+    }
+    
+    if (!area.isEmpty()) {
+        fitInView(area.adjusted(-GRID_SIZE, -GRID_SIZE, GRID_SIZE, GRID_SIZE), Qt::KeepAspectRatio);
+    }
+}
+
+void CircuitCanvas::setHighDensity(bool enabled)
+{
+    if (highDensity == enabled) {
+        return;
+    }
+    highDensity = enabled;
+    
+    if (enabled) {
+        createBatch();
+        demoteIdleItems();
+        return;
+    }
+    
+    delete batch;
+    batch = nullptr;
+    hoveredId = 0;
+    
+    // Every element gets its item back, except while the document is
+    // inactive; restoreItems builds them then
+    if (!released) {
+        scene->snapshot().forEach([this](const ElementRecord &record) {
+            promote(record.id);
+        });
+    }
+}
+
+void CircuitCanvas::createBatch()
+{
+    batch = new ElementBatchItem(&elementsById);
+    batch->setBounds(scene->sceneRect());
+    scene->addItem(batch);
+}
+
+// Gives a record-only element its interactive item. The record already
+// holds the element's state, so the scene is not notified.
+CircuitElement *CircuitCanvas::promote(quint64 id)
+{
+    if (CircuitElement *element = elementsById.value(id)) {
+        return element;
+    }
+    
+    ElementRecord record;
+    if (!scene->elementIndex().lookup(id, &record)) {
+        return nullptr;
+    }
+    
+    CircuitElement *element = createItem(record.id, record.type, record.pos);
+    element->setLabel(record.label);
+    attachItem(element);
+    return element;
+}
+
+// Drops the items of elements that are neither selected, hovered nor being
+// dragged; the batch item draws them from their records again.
+void CircuitCanvas::demoteIdleItems()
+{
+    demotionPending = false;
+    if (!highDensity) {
+        return;
+    }
+    
+    QGraphicsItem *grabber = scene->mouseGrabberItem();
+    for (int i = elements.size() - 1; i >= 0; --i) {
+        CircuitElement *element = elements.at(i);
+        if (element->isSelected() || element == grabber || element->getId() == hoveredId) {
+            continue;
+        }
+        elements.removeAt(i);
+        elementsById.remove(element->getId());
+        scene->removeItem(element);
+        delete element;
+    }
+}
+
+// Selection and hover change in the middle of the scene's event handling,
+// where items must not be deleted, so demotion waits for the event loop.
+void CircuitCanvas::scheduleDemotion()
+{
+    if (!highDensity || demotionPending) {
+        return;
+    }
+    demotionPending = true;
+    QMetaObject::invokeMethod(this, [this]() { demoteIdleItems(); }, Qt::QueuedConnection);
+}
+
+// The element whose symbol covers scenePos, the closest one if several do
+quint64 CircuitCanvas::elementAt(const QPointF &scenePos) const
+{
+    quint64 found = 0;
+    qreal nearest = 0;
+    
+    // Symbols are centered on their position
+    const QRectF area = CircuitElement::symbolRect().translated(scenePos);
+    scene->elementIndex().forEachInRect(area, [&](quint64 id, ElementType, const QPointF &pos, const QString &) {
+        QPointF offset = pos - scenePos;
+        qreal distance = QPointF::dotProduct(offset, offset);
+        if (!found || distance < nearest) {
+            found = id;
+            nearest = distance;
+        }
+    });
+    
+    return found;
+}
+
+// Rubber band selection only reaches items, so elements without one are
+// selected from the index once the band is released.
+void CircuitCanvas::trackRubberBand(const QRect &viewportRect, const QPointF &fromScenePoint,
+                                    const QPointF &toScenePoint)
+{
+    if (!viewportRect.isNull()) {
+        rubberBandArea = QRectF(fromScenePoint, toScenePoint).normalized();
+        return;
+    }
+    
+    const QRectF band = rubberBandArea;
+    rubberBandArea = QRectF();
+    if (!highDensity || band.isEmpty()) {
+        return;
+    }
+    
+    const QRectF symbol = CircuitElement::symbolRect();
+    QList<quint64> ids;
+    scene->elementIndex().forEachInRect(band.adjusted(symbol.left(), symbol.top(), symbol.right(), symbol.bottom()),
+        [&](quint64 id, ElementType, const QPointF &pos, const QString &) {
+            if (symbol.translated(pos).intersects(band)) {
+                ids.append(id);
+            }
+        });
+    
+    for (quint64 id : ids) {
+        promote(id)->setSelected(true);
     }
 }
 
@@ -76,26 +529,157 @@ void CircuitCanvas::wheelEvent(QWheelEvent *event)
     }
 }
 
-void CircuitCanvas::setupGrid()
+void CircuitCanvas::showDiff(const CircuitDiff &diff)
 {
-    QPen gridPen(Qt::lightGray, 0.5, Qt::DotLine);
+    diffOverlay = diff;
+    viewport()->update();
+}
+
+void CircuitCanvas::clearDiff()
+{
+    if (!diffOverlay.isEmpty()) {
+        diffOverlay = CircuitDiff();
+        viewport()->update();
+    }
+}
+
+void CircuitCanvas::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    if (diffOverlay.isEmpty()) {
+        return;
+    }
+    
+    const QRectF symbol = CircuitElement::symbolRect().adjusted(-4, -4, 4, 4);
+    painter->save();
+    painter->setBrush(Qt::NoBrush);
     
-    for (int x = -1000; x <= 1000; x += GRID_SIZE) {
-        scene->addLine(x, -1000, x, 1000, gridPen);
+    auto mark = [&](const QPointF &pos, const QColor &color, Qt::PenStyle style) {
+        QRectF area = symbol.translated(pos);
+        if (area.intersects(rect)) {
+            QPen pen(color, 2, style);
+            pen.setCosmetic(true);
+            painter->setPen(pen);
+            painter->drawRoundedRect(area, 4, 4);
+        }
+    };
+    
+    for (const ElementRecord &record : diffOverlay.added) {
+        mark(record.pos, QColor(0, 160, 0), Qt::SolidLine);
+    }
+    // Removed elements are no longer in the scene, only their outline is left
+    for (const ElementRecord &record : diffOverlay.removed) {
+        mark(record.pos, QColor(200, 0, 0), Qt::DashLine);
+    }
+    for (const CircuitDiff::Move &move : diffOverlay.moved) {
+        mark(move.from.pos, QColor(230, 140, 0), Qt::DotLine);
+        mark(move.to.pos, QColor(230, 140, 0), Qt::SolidLine);
+        
+        QLineF path(move.from.pos, move.to.pos);
+        if (rect.intersects(QRectF(path.p1(), path.p2()).normalized().adjusted(-1, -1, 1, 1))) {
+            QPen pen(QColor(230, 140, 0), 1, Qt::DashLine);
+            pen.setCosmetic(true);
+            painter->setPen(pen);
+            painter->drawLine(path);
+        }
+    }
+    for (const CircuitDiff::Move &relabel : diffOverlay.relabeled) {
+        mark(relabel.to.pos, QColor(0, 90, 200), Qt::SolidLine);
     }
     
-    for (int y = -1000; y <= 1000; y += GRID_SIZE) {
-        scene->addLine(-1000, y, 1000, y, gridPen);
+    painter->restore();
+}
+
+void CircuitCanvas::beginStaticLayer()
+{
+    staticTiles.clear();
+    staticTileTransform = transform();
+    staticLayerActive = true;
+    scene->setRenderLayer(CircuitScene::RenderLayer::Moving);
+}
+
+void CircuitCanvas::endStaticLayer()
+{
+    staticLayerActive = false;
+    staticTiles.clear();
+    scene->setRenderLayer(CircuitScene::RenderLayer::All);
+    viewport()->update();
+}
+
+void CircuitCanvas::invalidateStaticLayer(const QRectF &sceneRect)
+{
+    QRectF deviceRect = staticTileTransform.mapRect(sceneRect);
+    int firstColumn = int(std::floor(deviceRect.left() / TILE_SIZE));
+    int lastColumn = int(std::floor(deviceRect.right() / TILE_SIZE));
+    int firstRow = int(std::floor(deviceRect.top() / TILE_SIZE));
+    int lastRow = int(std::floor(deviceRect.bottom() / TILE_SIZE));
+    
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            staticTiles.remove(tileKey(column, row));
+        }
+    }
+    
+    scene->update(sceneRect);
+}
+
+quint64 CircuitCanvas::tileKey(int column, int row)
+{
+    return (quint64(quint32(column)) << 32) | quint32(row);
+}
+
+// Renders one tile of the static layer on first use. Tiles are laid out in
+// device pixels relative to the scene origin, so scrolling keeps them valid.
+const QPixmap &CircuitCanvas::staticTile(int column, int row)
+{
+    auto it = staticTiles.find(tileKey(column, row));
+    if (it != staticTiles.end()) {
+        return *it;
     }
     
-    QPen originPen(Qt::red, 2);
-    scene->addLine(-10, 0, 10, 0, originPen);
-    scene->addLine(0, -10, 0, 10, originPen);
+    QRectF sceneRect = staticTileTransform.inverted().mapRect(
+        QRectF(column * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE));
+    
+    const qreal ratio = devicePixelRatioF();
+    QPixmap tile(QSize(TILE_SIZE, TILE_SIZE) * ratio);
+    tile.setDevicePixelRatio(ratio);
+    tile.fill(viewport()->palette().color(viewport()->backgroundRole()));
+    
+    QPainter painter(&tile);
+    painter.setRenderHints(renderHints());
+    scene->setRenderLayer(CircuitScene::RenderLayer::Static);
+    scene->render(&painter, QRectF(0, 0, TILE_SIZE, TILE_SIZE), sceneRect, Qt::IgnoreAspectRatio);
+    scene->setRenderLayer(CircuitScene::RenderLayer::Moving);
+    painter.end();
+    
+    return *staticTiles.insert(tileKey(column, row), tile);
 }
 
-QPointF CircuitCanvas::snapToGrid(const QPointF &point)
+void CircuitCanvas::drawBackground(QPainter *painter, const QRectF &rect)
 {
-    qreal x = std::round(point.x() / GRID_SIZE) * GRID_SIZE;
-    qreal y = std::round(point.y() / GRID_SIZE) * GRID_SIZE;
-    return QPointF(x, y);
+    if (!staticLayerActive) {
+        QGraphicsView::drawBackground(painter, rect);
+        return;
+    }
+    
+    if (transform() != staticTileTransform) {
+        staticTiles.clear();
+        staticTileTransform = transform();
+    }
+    
+    QRectF deviceRect = staticTileTransform.mapRect(rect);
+    int firstColumn = int(std::floor(deviceRect.left() / TILE_SIZE));
+    int lastColumn = int(std::floor(deviceRect.right() / TILE_SIZE));
+    int firstRow = int(std::floor(deviceRect.top() / TILE_SIZE));
+    int lastRow = int(std::floor(deviceRect.bottom() / TILE_SIZE));
+    
+    QTransform toScene = staticTileTransform.inverted();
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            QRectF target = toScene.mapRect(
+                QRectF(column * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE));
+            const QPixmap &tile = staticTile(column, row);
+            painter->drawPixmap(target, tile, QRectF(tile.rect()));
+        }
+    }
 }
+
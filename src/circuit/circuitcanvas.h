@@ -6,7 +6,14 @@
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QList>
+#include <QHash>
+#include <QPixmap>
+#include <QTransform>
 #include "circuitelement.h"
+#include "circuitscene.h"
+#include "../diff/circuitdiff.h"
+
+class ElementBatchItem;
 
 class CircuitCanvas : public QGraphicsView
 {
@@ -17,25 +24,98 @@ public:
     
     void setActiveElementType(ElementType type);
     void clearCircuit();
-    QList<CircuitElement*> getElements() const { return elements; }
+    CircuitSnapshot snapshot() const { return scene->snapshot(); }
+    
+    // Inactive documents drop their graphics items and keep only the element
+    // records in the scene's store; restoreItems rebuilds them with their ids.
+    void releaseItems();
+    void restoreItems();
+    bool itemsReleased() const { return released; }
+    
+    // Elements are addressed by id, whether or not they currently have a
+    // graphics item.
+    quint64 addElement(ElementType type, const QPointF &pos);
+    void moveElement(quint64 id, const QPointF &pos);
+    void relabelElement(quint64 id, const QString &label);
+    void removeElement(quint64 id);
+    void importElements(const QList<ElementRecord> &records);
+    void applyRecords(const QList<ElementRecord> &records);
+    bool hasElement(quint64 id) const { return scene->elementIndex().contains(id); }
+    bool elementRecord(quint64 id, ElementRecord *record) const { return scene->elementIndex().lookup(id, record); }
+    
+    // Elements touched by the calls above, by editing or by dragging since
+    // the last call, see CircuitScene::takeChangedIds
+    QSet<quint64> takeChangedElements(bool *allChanged) { return scene->takeChangedIds(allChanged); }
+    
+    QList<quint64> findElements(const QString &query, QString *errorMessage) const;
+    void selectElements(const QList<quint64> &ids);
+    void zoomToElements(const QList<quint64> &ids);
+    
+    // In high-density mode elements are kept as records only and drawn in
+    // per-type batches by one batch item; the selected and hovered ones are promoted to
+    // interactive items and demoted again once they are neither.
+    void setHighDensity(bool enabled);
+    bool isHighDensity() const { return highDensity; }
+    
+    // Marks added, removed and moved elements on top of the circuit
+    void showDiff(const CircuitDiff &diff);
+    void clearDiff();
 
 signals:
     void circuitChanged();
 
 protected:
     void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
+    void drawBackground(QPainter *painter, const QRectF &rect) override;
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
+
+private slots:
+    void trackRubberBand(const QRect &viewportRect, const QPointF &fromScenePoint, const QPointF &toScenePoint);
 
 private:
-    QGraphicsScene *scene;
+    CircuitScene *scene;
     ElementType activeElementType;
     bool hasActiveElement;
     QList<CircuitElement*> elements;
+    QHash<quint64, CircuitElement*> elementsById;
+    quint64 nextElementId;
+    bool released;
+    CircuitDiff diffOverlay;
+    
+    CircuitElement *createItem(quint64 id, ElementType type, const QPointF &pos);
+    void attachItem(CircuitElement *element);
+    void updateRecordArea(const QPointF &pos);
+    
+    bool highDensity;
+    ElementBatchItem *batch;
+    quint64 hoveredId;
+    QRectF rubberBandArea;
+    bool demotionPending;
+    
+    void createBatch();
+    CircuitElement *promote(quint64 id);
+    void demoteIdleItems();
+    void scheduleDemotion();
+    quint64 elementAt(const QPointF &scenePos) const;
+    
+    // Static layer used while dragging: tiles of the viewport with
+    // everything but the dragged selection, keyed by device tile position.
+    bool staticLayerActive;
+    QHash<quint64, QPixmap> staticTiles;
+    QTransform staticTileTransform;
+    
+    void beginStaticLayer();
+    void endStaticLayer();
+    void invalidateStaticLayer(const QRectF &sceneRect);
+    const QPixmap &staticTile(int column, int row);
     
-    void setupGrid();
-    QPointF snapToGrid(const QPointF &point);
+    static quint64 tileKey(int column, int row);
     
-    static constexpr qreal GRID_SIZE = 20.0;
+    static constexpr qreal GRID_SIZE = CircuitScene::GRID_SIZE;
+    static constexpr int TILE_SIZE = 256;
 };
 
 #endif // CIRCUITCANVAS_H
@@ -1,4 +1,6 @@
 #include "circuitelement.h"
+#include "circuitscene.h"
+#include "symbolcache.h"
 #include <QPainter>
 #include <QStyleOptionGraphicsItem>
 #include <QGraphicsScene>
@@ -6,58 +8,76 @@
 CircuitElement::CircuitElement(ElementType type, QGraphicsItem *parent)
     : QGraphicsItem(parent)
     , elementType(type)
-    , elementLabel("")
+    , elementId(0)
+    , elementLabel(defaultLabel(type))
 {
     setFlag(ItemIsMovable);
     setFlag(ItemIsSelectable);
     setFlag(ItemSendsGeometryChanges);
-    
-    switch (type) {
-        case ElementType::Resistor:
-            elementLabel = "R";
-            break;
-        case ElementType::Capacitor:
-            elementLabel = "C";
-            break;
-        case ElementType::Inductor:
-            elementLabel = "L";
-            break;
-        case ElementType::VoltageSource:
-            elementLabel = "V";
-            break;
-        case ElementType::CurrentSource:
-            elementLabel = "I";
-            break;
-        case ElementType::Ground:
-            elementLabel = "GND";
-            break;
-        case ElementType::Node:
-            elementLabel = "";
-            break;
-    }
 }
 
 QRectF CircuitElement::boundingRect() const
+{
+    return symbolRect();
+}
+
+QRectF CircuitElement::symbolRect()
 {
     return QRectF(-ELEMENT_WIDTH/2, -ELEMENT_HEIGHT/2, ELEMENT_WIDTH, ELEMENT_HEIGHT);
 }
 
+void CircuitElement::setLabel(const QString &label)
+{
+    elementLabel = label;
+    
+    if (auto circuitScene = qobject_cast<CircuitScene*>(scene())) {
+        circuitScene->elementRelabeled(this);
+    }
+}
+
+ElementRecord CircuitElement::toRecord() const
+{
+    ElementRecord record;
+    record.id = elementId;
+    record.type = elementType;
+    record.pos = scenePos();
+    record.label = elementLabel;
+    return record;
+}
+
 void CircuitElement::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    Q_UNUSED(option)
     Q_UNUSED(widget)
     
+    auto circuitScene = qobject_cast<CircuitScene*>(scene());
+    if (circuitScene && !circuitScene->paintsElement(isSelected())) {
+        return;
+    }
+    
+    // Zoomed out, blit the shared pre-rendered symbol instead of stroking it
+    const qreal scale = option->levelOfDetailFromTransform(painter->worldTransform());
+    if (scale < 1.0) {
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+        painter->drawImage(symbolRect(), SymbolCache::instance().symbol(elementType, elementLabel, isSelected(), scale));
+        return;
+    }
+    
+    drawSymbol(painter, elementType, elementLabel, isSelected());
+}
+
+void CircuitElement::drawSymbol(QPainter *painter, ElementType type, const QString &label, bool selected)
+{
     painter->setRenderHint(QPainter::Antialiasing);
     
     QPen pen(Qt::black, 2);
-    if (isSelected()) {
+    if (selected) {
         pen.setColor(Qt::red);
         pen.setWidth(3);
     }
     painter->setPen(pen);
     painter->setBrush(Qt::NoBrush);
     
-    switch (elementType) {
+    switch (type) {
         case ElementType::Resistor:
             drawResistor(painter);
             break;
@@ -81,12 +101,12 @@ void CircuitElement::paint(QPainter *painter, const QStyleOptionGraphicsItem *op
             break;
     }
     
-    if (!elementLabel.isEmpty()) {
+    if (!label.isEmpty()) {
         painter->setPen(Qt::black);
         QFont font = painter->font();
         font.setPointSize(8);
         painter->setFont(font);
-        painter->drawText(boundingRect(), Qt::AlignCenter, elementLabel);
+        painter->drawText(symbolRect(), Qt::AlignCenter, label);
     }
 }
 
@@ -225,5 +245,11 @@ QVariant CircuitElement::itemChange(GraphicsItemChange change, const QVariant &v
         return QPointF(x, y);
     }
     
+    if (change == ItemPositionHasChanged) {
+        if (auto circuitScene = qobject_cast<CircuitScene*>(scene())) {
+            circuitScene->elementMoved(this);
+        }
+    }
+    
     return QGraphicsItem::itemChange(change, value);
 }
@@ -18,6 +18,14 @@ enum class ElementType {
     Node
 };
 
+// Plain copy of an element's state, safe to hand to other threads.
+struct ElementRecord {
+    quint64 id = 0;
+    ElementType type = ElementType::Resistor;
+    QPointF pos;
+    QString label;
+};
+
 class CircuitElement : public QGraphicsItem
 {
 public:
@@ -27,27 +35,61 @@ public:
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
     
     ElementType getType() const { return elementType; }
+    quint64 getId() const { return elementId; }
+    void setId(quint64 id) { elementId = id; }
     QString getTikZCode() const;
-    void setLabel(const QString &label) { elementLabel = label; }
+    void setLabel(const QString &label);
     QString getLabel() const { return elementLabel; }
+    ElementRecord toRecord() const;
+    
+    static QString defaultLabel(ElementType type);
+    
+    // Draws an element centered on the painter origin. Only touches its
+    // arguments, so it may be called from worker threads.
+    static void drawSymbol(QPainter *painter, ElementType type, const QString &label, bool selected);
+    static QRectF symbolRect();
 
 protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
 
 private:
     ElementType elementType;
+    quint64 elementId;
     QString elementLabel;
     static constexpr qreal ELEMENT_WIDTH = 60.0;
     static constexpr qreal ELEMENT_HEIGHT = 30.0;
     
     // Drawing methods for different elements
-    void drawResistor(QPainter *painter);
-    void drawCapacitor(QPainter *painter);
-    void drawInductor(QPainter *painter);
-    void drawVoltageSource(QPainter *painter);
-    void drawCurrentSource(QPainter *painter);
-    void drawGround(QPainter *painter);
-    void drawNode(QPainter *painter);
+    static void drawResistor(QPainter *painter);
+    static void drawCapacitor(QPainter *painter);
+    static void drawInductor(QPainter *painter);
+    static void drawVoltageSource(QPainter *painter);
+    static void drawCurrentSource(QPainter *painter);
+    static void drawGround(QPainter *painter);
+    static void drawNode(QPainter *painter);
 };
 
+// Defined here so that code reading TikZ back (parser, diff) does not need
+// the graphics item sources
+inline QString CircuitElement::defaultLabel(ElementType type)
+{
+    switch (type) {
+        case ElementType::Resistor:
+            return "R";
+        case ElementType::Capacitor:
+            return "C";
+        case ElementType::Inductor:
+            return "L";
+        case ElementType::VoltageSource:
+            return "V";
+        case ElementType::CurrentSource:
+            return "I";
+        case ElementType::Ground:
+            return "GND";
+        case ElementType::Node:
+            break;
+    }
+    return QString();
+}
+
 #endif // CIRCUITELEMENT_H
@@ -0,0 +1,137 @@
+#include "circuitscene.h"
+#include "circuitelement.h"
+#include <QPainter>
+#include <QPen>
+#include <QVarLengthArray>
+#include <QLineF>
+#include <cmath>
+#include <utility>
+
+CircuitScene::CircuitScene(QObject *parent)
+    : QGraphicsScene(parent)
+    , layer(RenderLayer::All)
+    , everythingChanged(false)
+{
+}
+
+bool CircuitScene::paintsElement(bool selected) const
+{
+    switch (layer) {
+        case RenderLayer::Static:
+            return !selected;
+        case RenderLayer::Moving:
+            return selected;
+        case RenderLayer::All:
+            break;
+    }
+    return true;
+}
+
+void CircuitScene::elementAdded(const CircuitElement *element)
+{
+    insertRecord(element->toRecord());
+}
+
+void CircuitScene::elementRemoved(const CircuitElement *element)
+{
+    removeRecord(element->getId());
+}
+
+void CircuitScene::elementMoved(const CircuitElement *element)
+{
+    moveRecord(element->getId(), element->scenePos());
+}
+
+void CircuitScene::elementRelabeled(const CircuitElement *element)
+{
+    relabelRecord(element->getId(), element->getLabel());
+}
+
+void CircuitScene::insertRecord(const ElementRecord &record)
+{
+    index.insert(record);
+    store.insert(record);
+    markChanged(record.id);
+}
+
+void CircuitScene::removeRecord(quint64 id)
+{
+    index.remove(id);
+    store.remove(id);
+    markChanged(id);
+}
+
+void CircuitScene::moveRecord(quint64 id, const QPointF &pos)
+{
+    index.move(id, pos);
+    store.move(id, pos);
+    markChanged(id);
+}
+
+void CircuitScene::relabelRecord(quint64 id, const QString &label)
+{
+    index.relabel(id, label);
+    store.relabel(id, label);
+    markChanged(id);
+}
+
+void CircuitScene::clearElements()
+{
+    index.clear();
+    store.clear();
+    changedIds.clear();
+    everythingChanged = true;
+}
+
+void CircuitScene::markChanged(quint64 id)
+{
+    if (everythingChanged) {
+        return;
+    }
+    changedIds.insert(id);
+    if (changedIds.size() > MAX_TRACKED_CHANGES) {
+        changedIds.clear();
+        everythingChanged = true;
+    }
+}
+
+QSet<quint64> CircuitScene::takeChangedIds(bool *allChanged)
+{
+    *allChanged = everythingChanged;
+    everythingChanged = false;
+    return std::exchange(changedIds, QSet<quint64>());
+}
+
+// The grid is painted as background instead of being made of line items,
+// so it never takes part in item lookup and only the exposed part is drawn.
+void CircuitScene::drawBackground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsScene::drawBackground(painter, rect);
+    
+    QRectF area = rect.intersected(sceneRect());
+    if (area.isEmpty()) {
+        return;
+    }
+    
+    // Lines span the whole scene so the dot pattern does not shift between
+    // partial repaints; the painter clips them to the exposed area.
+    const QRectF bounds = sceneRect();
+    QVarLengthArray<QLineF, 256> lines;
+    
+    qreal left = std::ceil(area.left() / GRID_SIZE) * GRID_SIZE;
+    for (qreal x = left; x <= area.right(); x += GRID_SIZE) {
+        lines.append(QLineF(x, bounds.top(), x, bounds.bottom()));
+    }
+    
+    qreal top = std::ceil(area.top() / GRID_SIZE) * GRID_SIZE;
+    for (qreal y = top; y <= area.bottom(); y += GRID_SIZE) {
+        lines.append(QLineF(bounds.left(), y, bounds.right(), y));
+    }
+    
+    painter->setPen(QPen(Qt::lightGray, 0.5, Qt::DotLine));
+    painter->drawLines(lines.constData(), int(lines.size()));
+    
+    painter->setPen(QPen(Qt::red, 2));
+    painter->drawLine(QLineF(-10, 0, 10, 0));
+    painter->drawLine(QLineF(0, -10, 0, 10));
+}
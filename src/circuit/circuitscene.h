@@ -0,0 +1,75 @@
+#ifndef CIRCUITSCENE_H
+#define CIRCUITSCENE_H
+
+#include <QGraphicsScene>
+#include <QSet>
+#include "elementindex.h"
+#include "circuitsnapshot.h"
+#include <cmath>
+
+class CircuitElement;
+
+class CircuitScene : public QGraphicsScene
+{
+    Q_OBJECT
+
+public:
+    // Which elements paint themselves. While a selection is dragged the
+    // view keeps everything else in a cached static layer and only the
+    // moving elements are drawn live.
+    enum class RenderLayer {
+        All,
+        Static,
+        Moving
+    };
+
+    explicit CircuitScene(QObject *parent = nullptr);
+
+    RenderLayer renderLayer() const { return layer; }
+    void setRenderLayer(RenderLayer renderLayer) { layer = renderLayer; }
+    bool paintsElement(bool selected) const;
+    
+    // Element bookkeeping, called by CircuitCanvas and CircuitElement
+    const ElementIndex &elementIndex() const { return index; }
+    CircuitSnapshot snapshot() const { return store.snapshot(); }
+    void elementAdded(const CircuitElement *element);
+    void elementRemoved(const CircuitElement *element);
+    void elementMoved(const CircuitElement *element);
+    void elementRelabeled(const CircuitElement *element);
+    void clearElements();
+    
+    // The same for elements that have no graphics item of their own
+    void insertRecord(const ElementRecord &record);
+    void removeRecord(quint64 id);
+    void moveRecord(quint64 id, const QPointF &pos);
+    void relabelRecord(quint64 id, const QString &label);
+    
+    // Ids of the elements added, moved, relabeled or removed since the last
+    // call. Past MAX_TRACKED_CHANGES, or after clearing, single ids are no
+    // longer kept and allChanged is set instead.
+    QSet<quint64> takeChangedIds(bool *allChanged);
+
+    static constexpr qreal GRID_SIZE = 20.0;
+    
+    static QPointF snapToGrid(const QPointF &point)
+    {
+        return QPointF(std::round(point.x() / GRID_SIZE) * GRID_SIZE,
+                       std::round(point.y() / GRID_SIZE) * GRID_SIZE);
+    }
+
+protected:
+    void drawBackground(QPainter *painter, const QRectF &rect) override;
+
+private:
+    void markChanged(quint64 id);
+    
+    RenderLayer layer;
+    ElementIndex index;
+    ElementStore store;
+    QSet<quint64> changedIds;
+    bool everythingChanged;
+    
+    static constexpr int MAX_TRACKED_CHANGES = 4096;
+};
+
+#endif // CIRCUITSCENE_H
@@ -0,0 +1,99 @@
+#include "circuitsnapshot.h"
+
+// Non-const access detaches the chunk list and the chunk if a snapshot
+// still shares them; all other chunks stay shared.
+ElementRecord &ElementStore::recordAt(int slot)
+{
+    return current.chunks[slot / CircuitSnapshot::CHUNK_SIZE][slot % CircuitSnapshot::CHUNK_SIZE];
+}
+
+void ElementStore::insert(const ElementRecord &record)
+{
+    auto existing = slots.constFind(record.id);
+    if (existing != slots.cend()) {
+        recordAt(*existing) = record;
+        ++current.revision;
+        return;
+    }
+    
+    if (current.used % CircuitSnapshot::CHUNK_SIZE == 0) {
+        current.chunks.append(QList<ElementRecord>());
+        current.chunks.last().reserve(CircuitSnapshot::CHUNK_SIZE);
+    }
+    current.chunks.last().append(record);
+    slots.insert(record.id, current.used);
+    ++current.used;
+    ++current.count;
+    ++current.revision;
+}
+
+// The record becomes a tombstone in place, so removal touches one chunk and
+// the remaining records keep their order.
+void ElementStore::remove(quint64 id)
+{
+    auto it = slots.find(id);
+    if (it == slots.end()) {
+        return;
+    }
+    
+    ElementRecord &record = recordAt(*it);
+    record.id = 0;
+    record.label.clear();
+    slots.erase(it);
+    --current.count;
+    ++current.revision;
+    
+    const int tombstones = current.used - current.count;
+    if (tombstones >= MIN_COMPACT_TOMBSTONES && tombstones * 2 >= current.used) {
+        compact();
+    }
+}
+
+// Rebuilds the chunks from the live records, in order
+void ElementStore::compact()
+{
+    QList<QList<ElementRecord>> chunks;
+    chunks.reserve((current.count + CircuitSnapshot::CHUNK_SIZE - 1) / CircuitSnapshot::CHUNK_SIZE);
+    slots.clear();
+    slots.reserve(current.count);
+    
+    int slot = 0;
+    current.forEach([&](const ElementRecord &record) {
+        if (slot % CircuitSnapshot::CHUNK_SIZE == 0) {
+            chunks.append(QList<ElementRecord>());
+            chunks.last().reserve(CircuitSnapshot::CHUNK_SIZE);
+        }
+        chunks.last().append(record);
+        slots.insert(record.id, slot++);
+    });
+    
+    current.chunks = chunks;
+    current.used = slot;
+}
+
+void ElementStore::move(quint64 id, const QPointF &pos)
+{
+    auto it = slots.constFind(id);
+    if (it != slots.cend()) {
+        recordAt(*it).pos = pos;
+        ++current.revision;
+    }
+}
+
+void ElementStore::relabel(quint64 id, const QString &label)
+{
+    auto it = slots.constFind(id);
+    if (it != slots.cend()) {
+        recordAt(*it).label = label;
+        ++current.revision;
+    }
+}
+
+void ElementStore::clear()
+{
+    current.chunks.clear();
+    current.count = 0;
+    current.used = 0;
+    ++current.revision;
+    slots.clear();
+}
@@ -0,0 +1,77 @@
+#ifndef CIRCUITSNAPSHOT_H
+#define CIRCUITSNAPSHOT_H
+
+#include <QList>
+#include <QHash>
+#include "circuitelement.h"
+
+// Immutable view of all element records at one point in time.
+//
+// Records are stored in fixed-size chunks held in implicitly shared Qt
+// containers. Taking a snapshot copies one container handle, and a later
+// edit on the GUI thread detaches only the chunk it touches (plus the small
+// chunk list once per snapshot), so a snapshot costs O(1) to hand out and
+// can be read from any thread without locking while editing continues.
+//
+// Records keep the order they were inserted in, so output generated from a
+// snapshot stays stable across deletions. A removed record leaves a
+// tombstone (id 0; element ids start at 1) that iteration skips until the
+// store compacts its chunks.
+class CircuitSnapshot
+{
+public:
+    CircuitSnapshot() = default;
+
+    int size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    quint64 version() const { return revision; }
+
+    template <typename Function>
+    void forEach(Function function) const
+    {
+        for (const QList<ElementRecord> &chunk : chunks) {
+            for (const ElementRecord &record : chunk) {
+                if (record.id) {
+                    function(record);
+                }
+            }
+        }
+    }
+
+    static constexpr int CHUNK_SIZE = 256;
+
+private:
+    friend class ElementStore;
+
+    QList<QList<ElementRecord>> chunks;
+    int count = 0;      // live records
+    int used = 0;       // slots, tombstones included
+    quint64 revision = 0;
+};
+
+// Mutable side of CircuitSnapshot, owned by CircuitScene and only touched
+// from the GUI thread.
+class ElementStore
+{
+public:
+    void insert(const ElementRecord &record);
+    void remove(quint64 id);
+    void move(quint64 id, const QPointF &pos);
+    void relabel(quint64 id, const QString &label);
+    void clear();
+
+    CircuitSnapshot snapshot() const { return current; }
+
+private:
+    ElementRecord &recordAt(int slot);
+    void compact();
+
+    CircuitSnapshot current;
+    QHash<quint64, int> slots;
+
+    // Compaction rewrites every chunk, so it waits until tombstones make up
+    // half of the slots; that keeps removal amortized O(1).
+    static constexpr int MIN_COMPACT_TOMBSTONES = 1024;
+};
+
+#endif // CIRCUITSNAPSHOT_H
@@ -0,0 +1,138 @@
+#include "elementbatchitem.h"
+#include "circuitscene.h"
+#include "symbolcache.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iterator>
+
+ElementBatchItem::ElementBatchItem(const QHash<quint64, CircuitElement*> *items)
+    : items(items)
+{
+    std::fill(std::begin(bodySteps), std::end(bodySteps), INT_MIN);
+    setFlag(ItemUsesExtendedStyleOption);
+    setAcceptedMouseButtons(Qt::NoButton);
+    setAcceptHoverEvents(false);
+    setZValue(-1);
+}
+
+void ElementBatchItem::setBounds(const QRectF &rect)
+{
+    prepareGeometryChange();
+    bounds = rect;
+}
+
+// The label is drawn separately, so one pixmap serves every element of a type
+const QPixmap &ElementBatchItem::bodyPixmap(ElementType type, int step)
+{
+    const int slot = int(type);
+    if (step != bodySteps[slot]) {
+        bodies[slot] = QPixmap::fromImage(SymbolCache::instance().symbol(type, QString(), false,
+                                                                         SymbolCache::stepScale(step)));
+        bodySteps[slot] = step;
+    }
+    return bodies[slot];
+}
+
+void ElementBatchItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(widget)
+    
+    auto circuitScene = static_cast<CircuitScene*>(scene());
+    if (!circuitScene->paintsElement(false)) {
+        return;
+    }
+    
+    const ElementIndex &index = circuitScene->elementIndex();
+    const qreal scale = option->levelOfDetailFromTransform(painter->worldTransform());
+    const QRectF symbol = CircuitElement::symbolRect();
+    
+    // Scene renders, like the static layer tiles, expose the whole item and
+    // only clip the painter
+    QRectF exposed = option->exposedRect;
+    if (painter->hasClipping()) {
+        exposed &= painter->clipBoundingRect();
+    }
+
+    // Elements are found by position; widen the area by half a symbol so
+    // partly exposed ones are included
+    const QRectF area = exposed.adjusted(symbol.left(), symbol.top(),
+                                         symbol.right(), symbol.bottom());
+    int firstColumn = int(std::floor(area.left() / TILE_SIZE));
+    int lastColumn = int(std::floor(area.right() / TILE_SIZE));
+    int firstRow = int(std::floor(area.top() / TILE_SIZE));
+    int lastRow = int(std::floor(area.bottom() / TILE_SIZE));
+    
+    // Zoomed in, symbols are few and drawn as vectors to stay sharp
+    if (scale >= 1.0) {
+        index.forEachInRect(area, [&](quint64 id, ElementType type, const QPointF &pos, const QString &label) {
+            if (items->contains(id)) {
+                return;
+            }
+            painter->save();
+            painter->translate(pos);
+            CircuitElement::drawSymbol(painter, type, label, false);
+            painter->restore();
+        });
+        return;
+    }
+    
+    const int step = SymbolCache::scaleStep(scale);
+    const qreal inverse = 1.0 / SymbolCache::stepScale(step);
+    const bool drawLabels = scale >= LABEL_MIN_SCALE;
+    
+    QRectF sources[TYPE_COUNT];
+    for (int type = 0; type < TYPE_COUNT; ++type) {
+        sources[type] = QRectF(bodyPixmap(ElementType(type), step).rect());
+    }
+    
+    struct Label {
+        QPointF pos;
+        QString text;
+    };
+    QVarLengthArray<QPainter::PixmapFragment, 64> fragments[TYPE_COUNT];
+    QVarLengthArray<Label, 64> labels;
+    
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    QFont font = painter->font();
+    font.setPointSize(8);
+    painter->setFont(font);
+    painter->setPen(Qt::black);
+    
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            QRectF tile = QRectF(column * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE) & area;
+            for (auto &bucket : fragments) {
+                bucket.clear();
+            }
+            labels.clear();
+            
+            index.forEachInRect(tile, [&](quint64 id, ElementType type, const QPointF &pos, const QString &label) {
+                // Positions on a tile edge belong to the tile right or below it
+                if (items->contains(id)
+                    || int(std::floor(pos.x() / TILE_SIZE)) != column
+                    || int(std::floor(pos.y() / TILE_SIZE)) != row) {
+                    return;
+                }
+                fragments[int(type)].append(
+                    QPainter::PixmapFragment::create(pos, sources[int(type)], inverse, inverse));
+                if (drawLabels && !label.isEmpty()) {
+                    labels.append({ pos, label });
+                }
+            });
+            
+            for (int type = 0; type < TYPE_COUNT; ++type) {
+                if (!fragments[type].isEmpty()) {
+                    painter->drawPixmapFragments(fragments[type].constData(), int(fragments[type].size()),
+                                                 bodyPixmap(ElementType(type), step));
+                }
+            }
+            for (const Label &label : labels) {
+                painter->drawText(symbol.translated(label.pos), Qt::AlignCenter, label.text);
+            }
+        }
+    }
+}
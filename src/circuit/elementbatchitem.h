@@ -0,0 +1,40 @@
+#ifndef ELEMENTBATCHITEM_H
+#define ELEMENTBATCHITEM_H
+
+#include <QGraphicsItem>
+#include <QHash>
+#include <QPixmap>
+#include "circuitelement.h"
+
+// Draws the elements straight from the scene's index, for the canvas's
+// high-density mode. The exposed area is cut into tiles; each tile's
+// elements are culled through the spatial index in a single pass, bucketed
+// by type and drawn as fragments of the type's symbol pixmap, one call per
+// type and tile. An element costs an index entry instead of a graphics
+// item. Elements that have an item of their own (selected or hovered ones)
+// are skipped.
+class ElementBatchItem : public QGraphicsItem
+{
+public:
+    explicit ElementBatchItem(const QHash<quint64, CircuitElement*> *items);
+
+    QRectF boundingRect() const override { return bounds; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+    void setBounds(const QRectF &rect);
+
+private:
+    const QPixmap &bodyPixmap(ElementType type, int step);
+
+    const QHash<quint64, CircuitElement*> *items;
+    QRectF bounds;
+
+    static constexpr int TYPE_COUNT = int(ElementType::Node) + 1;
+    QPixmap bodies[TYPE_COUNT];
+    int bodySteps[TYPE_COUNT];
+
+    static constexpr int TILE_SIZE = 512;
+    static constexpr qreal LABEL_MIN_SCALE = 0.5;
+};
+
+#endif // ELEMENTBATCHITEM_H
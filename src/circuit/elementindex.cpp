@@ -0,0 +1,307 @@
+#include "elementindex.h"
+#include <cmath>
+
+void ElementIndex::insert(const ElementRecord &record)
+{
+    remove(record.id);
+    
+    Entry entry{record.type, record.pos, record.label};
+    entries.insert(record.id, entry);
+    byType[int(entry.type)].insert(record.id);
+    byLabel[entry.label].insert(record.id);
+    addLocation(record.id, entry);
+}
+
+void ElementIndex::remove(quint64 id)
+{
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        return;
+    }
+    
+    const Entry &entry = *it;
+    byType[int(entry.type)].remove(id);
+    
+    auto label = byLabel.find(entry.label);
+    label->remove(id);
+    if (label->isEmpty()) {
+        byLabel.erase(label);
+    }
+    
+    removeLocation(id, entry);
+    entries.erase(it);
+}
+
+void ElementIndex::move(quint64 id, const QPointF &pos)
+{
+    auto it = entries.find(id);
+    if (it == entries.end() || it->pos == pos) {
+        return;
+    }
+    
+    removeLocation(id, *it);
+    it->pos = pos;
+    addLocation(id, *it);
+}
+
+void ElementIndex::relabel(quint64 id, const QString &label)
+{
+    auto it = entries.find(id);
+    if (it == entries.end() || it->label == label) {
+        return;
+    }
+    
+    auto old = byLabel.find(it->label);
+    old->remove(id);
+    if (old->isEmpty()) {
+        byLabel.erase(old);
+    }
+    
+    it->label = label;
+    byLabel[label].insert(id);
+}
+
+void ElementIndex::clear()
+{
+    entries.clear();
+    byType.clear();
+    byLabel.clear();
+    cells.clear();
+    byTerminal.clear();
+}
+
+void ElementIndex::addLocation(quint64 id, const Entry &entry)
+{
+    cells[cellKey(int(std::floor(entry.pos.x() / CELL_SIZE)),
+                  int(std::floor(entry.pos.y() / CELL_SIZE)))].insert(id);
+    
+    for (const QPointF &terminal : terminals(entry.type, entry.pos)) {
+        byTerminal[pointKey(terminal)].insert(id);
+    }
+}
+
+void ElementIndex::removeLocation(quint64 id, const Entry &entry)
+{
+    auto cell = cells.find(cellKey(int(std::floor(entry.pos.x() / CELL_SIZE)),
+                                   int(std::floor(entry.pos.y() / CELL_SIZE))));
+    if (cell != cells.end()) {
+        cell->remove(id);
+        if (cell->isEmpty()) {
+            cells.erase(cell);
+        }
+    }
+    
+    for (const QPointF &terminal : terminals(entry.type, entry.pos)) {
+        auto node = byTerminal.find(pointKey(terminal));
+        if (node != byTerminal.end()) {
+            node->remove(id);
+            if (node->isEmpty()) {
+                byTerminal.erase(node);
+            }
+        }
+    }
+}
+
+QList<quint64> ElementIndex::ofType(ElementType type) const
+{
+    const QSet<quint64> ids = byType.value(int(type));
+    return QList<quint64>(ids.cbegin(), ids.cend());
+}
+
+// Only labels sharing the literal prefix of the pattern are visited, found
+// by a range scan over the sorted label map.
+QList<quint64> ElementIndex::withLabel(const QString &pattern) const
+{
+    QList<quint64> result;
+    
+    qsizetype wildcard = 0;
+    while (wildcard < pattern.size()
+           && pattern.at(wildcard) != QLatin1Char('*') && pattern.at(wildcard) != QLatin1Char('?')) {
+        ++wildcard;
+    }
+    
+    if (wildcard == pattern.size()) {
+        auto it = byLabel.constFind(pattern);
+        if (it != byLabel.cend()) {
+            for (quint64 id : it.value()) {
+                result.append(id);
+            }
+        }
+        return result;
+    }
+    
+    const QString prefix = pattern.left(wildcard);
+    
+    for (auto it = byLabel.lowerBound(prefix); it != byLabel.cend() && it.key().startsWith(prefix); ++it) {
+        if (matchesWildcard(it.key(), pattern)) {
+            for (quint64 id : it.value()) {
+                result.append(id);
+            }
+        }
+    }
+    
+    return result;
+}
+
+QList<quint64> ElementIndex::inRect(const QRectF &rect) const
+{
+    QList<quint64> result;
+    forEachInRect(rect, [&result](quint64 id, ElementType, const QPointF &, const QString &) {
+        result.append(id);
+    });
+    return result;
+}
+
+bool ElementIndex::lookup(quint64 id, ElementRecord *record) const
+{
+    auto it = entries.constFind(id);
+    if (it == entries.cend()) {
+        return false;
+    }
+    
+    record->id = id;
+    record->type = it->type;
+    record->pos = it->pos;
+    record->label = it->label;
+    return true;
+}
+
+int ElementIndex::estimateOfType(ElementType type) const
+{
+    auto it = byType.constFind(int(type));
+    return it == byType.cend() ? 0 : int(it->size());
+}
+
+int ElementIndex::estimateWithLabel(const QString &pattern) const
+{
+    qsizetype wildcard = 0;
+    while (wildcard < pattern.size()
+           && pattern.at(wildcard) != QLatin1Char('*') && pattern.at(wildcard) != QLatin1Char('?')) {
+        ++wildcard;
+    }
+    
+    if (wildcard == pattern.size()) {
+        auto it = byLabel.constFind(pattern);
+        return it == byLabel.cend() ? 0 : int(it->size());
+    }
+    
+    // Without a literal prefix every label is in range
+    const QString prefix = pattern.left(wildcard);
+    if (prefix.isEmpty()) {
+        return size();
+    }
+    
+    int count = 0;
+    for (auto it = byLabel.lowerBound(prefix); it != byLabel.cend() && it.key().startsWith(prefix); ++it) {
+        count += int(it->size());
+    }
+    return count;
+}
+
+int ElementIndex::estimateInRect(const QRectF &rect) const
+{
+    if (cells.isEmpty()) {
+        return 0;
+    }
+    
+    const QRectF area = rect.normalized();
+    qint64 columns = qint64(std::floor(area.right() / CELL_SIZE)) - qint64(std::floor(area.left() / CELL_SIZE)) + 1;
+    qint64 rows = qint64(std::floor(area.bottom() / CELL_SIZE)) - qint64(std::floor(area.top() / CELL_SIZE)) + 1;
+    qint64 covered = qMin(columns * rows, qint64(cells.size()));
+    
+    return int(qMin(qint64(size()), (covered * size() + cells.size() - 1) / cells.size()));
+}
+
+int ElementIndex::estimateAtNode(const QPointF &point) const
+{
+    auto it = byTerminal.constFind(pointKey(point));
+    return it == byTerminal.cend() ? 0 : int(it->size());
+}
+
+QList<quint64> ElementIndex::atNode(const QPointF &point) const
+{
+    const QSet<quint64> ids = byTerminal.value(pointKey(point));
+    return QList<quint64>(ids.cbegin(), ids.cend());
+}
+
+bool ElementIndex::hasType(quint64 id, ElementType type) const
+{
+    auto it = entries.constFind(id);
+    return it != entries.cend() && it->type == type;
+}
+
+bool ElementIndex::labelMatches(quint64 id, const QString &pattern) const
+{
+    auto it = entries.constFind(id);
+    return it != entries.cend() && matchesWildcard(it->label, pattern);
+}
+
+bool ElementIndex::isInRect(quint64 id, const QRectF &rect) const
+{
+    auto it = entries.constFind(id);
+    return it != entries.cend() && rect.normalized().contains(it->pos);
+}
+
+bool ElementIndex::touchesNode(quint64 id, const QPointF &point) const
+{
+    auto it = byTerminal.constFind(pointKey(point));
+    return it != byTerminal.cend() && it->contains(id);
+}
+
+// Terminal points as emitted by TikzGenerator: two-terminal parts run two
+// TikZ units (40 pixels) to the right, sources two units downwards.
+QList<QPointF> ElementIndex::terminals(ElementType type, const QPointF &pos)
+{
+    switch (type) {
+        case ElementType::Resistor:
+        case ElementType::Capacitor:
+        case ElementType::Inductor:
+            return { pos, pos + QPointF(40, 0) };
+        case ElementType::VoltageSource:
+        case ElementType::CurrentSource:
+            return { pos, pos + QPointF(0, 40) };
+        case ElementType::Ground:
+        case ElementType::Node:
+            break;
+    }
+    return { pos };
+}
+
+// Glob match supporting '*' and '?', without building a regular expression
+bool ElementIndex::matchesWildcard(QStringView text, QStringView pattern)
+{
+    qsizetype t = 0;
+    qsizetype p = 0;
+    qsizetype starPattern = -1;
+    qsizetype starText = 0;
+    
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == QLatin1Char('?') || pattern[p] == text[t])) {
+            ++t;
+            ++p;
+        } else if (p < pattern.size() && pattern[p] == QLatin1Char('*')) {
+            starPattern = p++;
+            starText = t;
+        } else if (starPattern >= 0) {
+            p = starPattern + 1;
+            t = ++starText;
+        } else {
+            return false;
+        }
+    }
+    
+    while (p < pattern.size() && pattern[p] == QLatin1Char('*')) {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+quint64 ElementIndex::cellKey(int column, int row)
+{
+    return (quint64(quint32(column)) << 32) | quint32(row);
+}
+
+quint64 ElementIndex::pointKey(const QPointF &point)
+{
+    return cellKey(qRound(point.x()), qRound(point.y()));
+}
@@ -0,0 +1,117 @@
+#ifndef ELEMENTINDEX_H
+#define ELEMENTINDEX_H
+
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <QString>
+#include "circuitelement.h"
+#include <cmath>
+
+// Lookup structures over the elements of a circuit, kept up to date by
+// CircuitScene as elements are added, moved, relabeled and removed:
+// per type, per label (sorted, for prefix ranges), a uniform spatial grid
+// of element positions and a map of terminal points.
+class ElementIndex
+{
+public:
+    void insert(const ElementRecord &record);
+    void remove(quint64 id);
+    void move(quint64 id, const QPointF &pos);
+    void relabel(quint64 id, const QString &label);
+    void clear();
+
+    int size() const { return entries.size(); }
+    bool contains(quint64 id) const { return entries.contains(id); }
+    QList<quint64> allIds() const { return entries.keys(); }
+    bool lookup(quint64 id, ElementRecord *record) const;
+
+    QList<quint64> ofType(ElementType type) const;
+    QList<quint64> withLabel(const QString &pattern) const;
+    QList<quint64> inRect(const QRectF &rect) const;
+    QList<quint64> atNode(const QPointF &point) const;
+
+    // Calls function(id, type, pos, label) for every element positioned
+    // inside rect, without building a list
+    template <typename Function>
+    void forEachInRect(const QRectF &rect, Function function) const;
+
+    // Candidate counts for query planning: exact for type and node, the
+    // ids under labels sharing the pattern's literal prefix, and occupied
+    // cells in the rectangle times the average elements per cell
+    int estimateOfType(ElementType type) const;
+    int estimateWithLabel(const QString &pattern) const;
+    int estimateInRect(const QRectF &rect) const;
+    int estimateAtNode(const QPointF &point) const;
+
+    bool hasType(quint64 id, ElementType type) const;
+    bool labelMatches(quint64 id, const QString &pattern) const;
+    bool isInRect(quint64 id, const QRectF &rect) const;
+    bool touchesNode(quint64 id, const QPointF &point) const;
+
+    static QList<QPointF> terminals(ElementType type, const QPointF &pos);
+    static bool matchesWildcard(QStringView text, QStringView pattern);
+
+private:
+    struct Entry {
+        ElementType type;
+        QPointF pos;
+        QString label;
+    };
+
+    void addLocation(quint64 id, const Entry &entry);
+    void removeLocation(quint64 id, const Entry &entry);
+    static quint64 cellKey(int column, int row);
+    static quint64 pointKey(const QPointF &point);
+
+    QHash<quint64, Entry> entries;
+    QHash<int, QSet<quint64>> byType;
+    QMap<QString, QSet<quint64>> byLabel;
+    QHash<quint64, QSet<quint64>> cells;
+    QHash<quint64, QSet<quint64>> byTerminal;
+
+    static constexpr qreal CELL_SIZE = 100.0;
+};
+
+template <typename Function>
+void ElementIndex::forEachInRect(const QRectF &rect, Function function) const
+{
+    const QRectF area = rect.normalized();
+    auto visit = [&](const QSet<quint64> &cell) {
+        for (quint64 id : cell) {
+            const Entry &entry = *entries.constFind(id);
+            if (area.contains(entry.pos)) {
+                function(id, entry.type, entry.pos, entry.label);
+            }
+        }
+    };
+    
+    int firstColumn = int(std::floor(area.left() / CELL_SIZE));
+    int lastColumn = int(std::floor(area.right() / CELL_SIZE));
+    int firstRow = int(std::floor(area.top() / CELL_SIZE));
+    int lastRow = int(std::floor(area.bottom() / CELL_SIZE));
+    
+    // A rectangle spanning more cells than there are occupied ones is
+    // cheaper to answer from the occupied cells directly.
+    qint64 cellCount = qint64(lastColumn - firstColumn + 1) * (lastRow - firstRow + 1);
+    if (cellCount > cells.size()) {
+        for (auto cell = cells.cbegin(); cell != cells.cend(); ++cell) {
+            visit(cell.value());
+        }
+        return;
+    }
+    
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            auto cell = cells.constFind(cellKey(column, row));
+            if (cell != cells.cend()) {
+                visit(cell.value());
+            }
+        }
+    }
+}
+
+#endif // ELEMENTINDEX_H
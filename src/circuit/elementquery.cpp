@@ -0,0 +1,178 @@
+#include "elementquery.h"
+#include "elementindex.h"
+#include <QStringList>
+#include <algorithm>
+
+bool ElementQuery::parse(const QString &text, ElementQuery *query, QString *errorMessage)
+{
+    query->terms.clear();
+    
+    const QStringList parts = text.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    if (parts.isEmpty()) {
+        *errorMessage = QStringLiteral("Empty query");
+        return false;
+    }
+    
+    for (const QString &part : parts) {
+        qsizetype equals = part.indexOf(QLatin1Char('='));
+        if (equals <= 0) {
+            *errorMessage = QStringLiteral("Expected key=value, got '%1'").arg(part);
+            return false;
+        }
+        
+        const QString key = part.left(equals).toLower();
+        const QString value = part.mid(equals + 1);
+        Term term;
+        
+        if (key == QLatin1String("type")) {
+            term.kind = TermKind::Type;
+            if (!parseType(value, &term.type)) {
+                *errorMessage = QStringLiteral("Unknown element type '%1'").arg(value);
+                return false;
+            }
+        } else if (key == QLatin1String("label")) {
+            term.kind = TermKind::Label;
+            term.pattern = value;
+        } else if (key == QLatin1String("in") || key == QLatin1String("node")) {
+            const QStringList numbers = value.split(QLatin1Char(','));
+            QList<qreal> coordinates;
+            for (const QString &number : numbers) {
+                bool ok = false;
+                coordinates.append(number.toDouble(&ok) * TIKZ_TO_GRID_SCALE);
+                if (!ok) {
+                    *errorMessage = QStringLiteral("Invalid coordinate '%1'").arg(number);
+                    return false;
+                }
+            }
+            
+            // TikZ y grows upwards, scene y downwards
+            if (key == QLatin1String("in") && coordinates.size() == 4) {
+                term.kind = TermKind::Rect;
+                term.rect = QRectF(QPointF(coordinates[0], -coordinates[1]),
+                                   QPointF(coordinates[2], -coordinates[3])).normalized();
+            } else if (key == QLatin1String("node") && coordinates.size() == 2) {
+                term.kind = TermKind::Node;
+                term.point = QPointF(coordinates[0], -coordinates[1]);
+            } else {
+                *errorMessage = QStringLiteral("Wrong number of coordinates in '%1'").arg(part);
+                return false;
+            }
+        } else {
+            *errorMessage = QStringLiteral("Unknown query key '%1'").arg(key);
+            return false;
+        }
+        
+        query->terms.append(term);
+    }
+    
+    // Cheapest checks first when filtering; run() still picks the term with
+    // the fewest candidates to produce them.
+    std::stable_sort(query->terms.begin(), query->terms.end(), [](const Term &a, const Term &b) {
+        return int(a.kind) < int(b.kind);
+    });
+    
+    return true;
+}
+
+bool ElementQuery::parseType(const QString &value, ElementType *type)
+{
+    const QString name = value.toLower();
+    
+    if (name == QLatin1String("resistor") || name == QLatin1String("r")) {
+        *type = ElementType::Resistor;
+    } else if (name == QLatin1String("capacitor") || name == QLatin1String("c")) {
+        *type = ElementType::Capacitor;
+    } else if (name == QLatin1String("inductor") || name == QLatin1String("l")) {
+        *type = ElementType::Inductor;
+    } else if (name == QLatin1String("voltagesource") || name == QLatin1String("v")) {
+        *type = ElementType::VoltageSource;
+    } else if (name == QLatin1String("currentsource") || name == QLatin1String("i")) {
+        *type = ElementType::CurrentSource;
+    } else if (name == QLatin1String("ground") || name == QLatin1String("gnd")) {
+        *type = ElementType::Ground;
+    } else if (name == QLatin1String("node")) {
+        *type = ElementType::Node;
+    } else {
+        return false;
+    }
+    
+    return true;
+}
+
+QList<quint64> ElementQuery::run(const ElementIndex &index) const
+{
+    if (terms.isEmpty()) {
+        return QList<quint64>();
+    }
+    
+    // The term with the fewest candidates produces them, the others only
+    // filter; ties keep the parse order
+    int driver = 0;
+    int fewest = estimate(index, terms.first());
+    for (int i = 1; i < terms.size() && fewest > 0; ++i) {
+        int count = estimate(index, terms.at(i));
+        if (count < fewest) {
+            driver = i;
+            fewest = count;
+        }
+    }
+    
+    QList<quint64> result = candidates(index, terms.at(driver));
+    
+    for (int i = 0; i < terms.size(); ++i) {
+        if (i == driver) {
+            continue;
+        }
+        const Term &term = terms.at(i);
+        result.erase(std::remove_if(result.begin(), result.end(), [&](quint64 id) {
+            return !matches(index, id, term);
+        }), result.end());
+    }
+    
+    return result;
+}
+
+QList<quint64> ElementQuery::candidates(const ElementIndex &index, const Term &term) const
+{
+    switch (term.kind) {
+        case TermKind::Node:
+            return index.atNode(term.point);
+        case TermKind::Rect:
+            return index.inRect(term.rect);
+        case TermKind::Label:
+            return index.withLabel(term.pattern);
+        case TermKind::Type:
+            return index.ofType(term.type);
+    }
+    return QList<quint64>();
+}
+
+int ElementQuery::estimate(const ElementIndex &index, const Term &term) const
+{
+    switch (term.kind) {
+        case TermKind::Node:
+            return index.estimateAtNode(term.point);
+        case TermKind::Rect:
+            return index.estimateInRect(term.rect);
+        case TermKind::Label:
+            return index.estimateWithLabel(term.pattern);
+        case TermKind::Type:
+            return index.estimateOfType(term.type);
+    }
+    return 0;
+}
+
+bool ElementQuery::matches(const ElementIndex &index, quint64 id, const Term &term) const
+{
+    switch (term.kind) {
+        case TermKind::Node:
+            return index.touchesNode(id, term.point);
+        case TermKind::Rect:
+            return index.isInRect(id, term.rect);
+        case TermKind::Label:
+            return index.labelMatches(id, term.pattern);
+        case TermKind::Type:
+            return index.hasType(id, term.type);
+    }
+    return false;
+}
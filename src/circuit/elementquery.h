@@ -0,0 +1,53 @@
+#ifndef ELEMENTQUERY_H
+#define ELEMENTQUERY_H
+
+#include <QList>
+#include <QString>
+#include <QRectF>
+#include <QPointF>
+#include "circuitelement.h"
+
+class ElementIndex;
+
+// Query over an ElementIndex. A query is a space separated list of terms
+// that must all hold; coordinates are given in TikZ units as shown in the
+// code view:
+//
+//   type=Resistor           element type (R, C, L, V, I, GND, Node work too)
+//   label=R_1*              label, '*' and '?' as wildcards
+//   in=x1,y1,x2,y2          position inside the rectangle
+//   node=x,y                one of the element's terminals lies on the point
+class ElementQuery
+{
+public:
+    static bool parse(const QString &text, ElementQuery *query, QString *errorMessage);
+
+    QList<quint64> run(const ElementIndex &index) const;
+
+private:
+    enum class TermKind {
+        Node,
+        Rect,
+        Label,
+        Type
+    };
+
+    struct Term {
+        TermKind kind = TermKind::Type;
+        ElementType type = ElementType::Resistor;
+        QString pattern;
+        QRectF rect;
+        QPointF point;
+    };
+
+    static bool parseType(const QString &value, ElementType *type);
+    QList<quint64> candidates(const ElementIndex &index, const Term &term) const;
+    int estimate(const ElementIndex &index, const Term &term) const;
+    bool matches(const ElementIndex &index, quint64 id, const Term &term) const;
+
+    QList<Term> terms;
+
+    static constexpr qreal TIKZ_TO_GRID_SCALE = 20.0;
+};
+
+#endif // ELEMENTQUERY_H
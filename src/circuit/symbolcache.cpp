@@ -0,0 +1,56 @@
+#include "symbolcache.h"
+#include <QMutexLocker>
+#include <QPainter>
+#include <QHashFunctions>
+#include <QtMath>
+#include <cmath>
+
+size_t qHash(const SymbolCache::Key &key, size_t seed)
+{
+    return qHashMulti(seed, int(key.type), key.selected, key.scaleStep, key.label);
+}
+
+SymbolCache::SymbolCache()
+    : images(CACHE_COST_LIMIT)
+{
+}
+
+SymbolCache &SymbolCache::instance()
+{
+    static SymbolCache cache;
+    return cache;
+}
+
+// Symbols are rendered at the next power of two at or above the requested
+// scale, so zooming only creates a handful of variants per symbol.
+int SymbolCache::scaleStep(qreal scale)
+{
+    return qBound(MIN_SCALE_STEP, int(std::ceil(std::log2(qMax(scale, 1e-3)))), 0);
+}
+
+QImage SymbolCache::symbol(ElementType type, const QString &label, bool selected, qreal scale)
+{
+    int step = scaleStep(scale);
+    Key key{type, selected, step, label};
+    
+    QMutexLocker locker(&mutex);
+    if (QImage *cached = images.object(key)) {
+        return *cached;
+    }
+    
+    const qreal renderScale = stepScale(step);
+    const QRectF rect = CircuitElement::symbolRect();
+    QImage image(qMax(1, qCeil(rect.width() * renderScale)),
+                 qMax(1, qCeil(rect.height() * renderScale)),
+                 QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    
+    QPainter painter(&image);
+    painter.scale(renderScale, renderScale);
+    painter.translate(-rect.topLeft());
+    CircuitElement::drawSymbol(&painter, type, label, selected);
+    painter.end();
+    
+    images.insert(key, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes()));
+    return image;
+}
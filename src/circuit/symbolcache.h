@@ -0,0 +1,49 @@
+#ifndef SYMBOLCACHE_H
+#define SYMBOLCACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <cmath>
+#include "circuitelement.h"
+
+// Process-wide cache of rasterized element symbols, shared by every open
+// document. Zoomed-out views blit these images instead of stroking each
+// symbol. Safe to use from any thread.
+class SymbolCache
+{
+public:
+    static SymbolCache &instance();
+
+    QImage symbol(ElementType type, const QString &label, bool selected, qreal scale);
+    
+    // Symbols are rendered at 2^step for the step that covers a view scale
+    static int scaleStep(qreal scale);
+    static qreal stepScale(int step) { return std::ldexp(1.0, step); }
+
+private:
+    SymbolCache();
+
+    struct Key {
+        ElementType type;
+        bool selected;
+        int scaleStep;
+        QString label;
+
+        bool operator==(const Key &other) const
+        {
+            return type == other.type && selected == other.selected
+                && scaleStep == other.scaleStep && label == other.label;
+        }
+    };
+    friend size_t qHash(const Key &key, size_t seed);
+
+    QMutex mutex;
+    QCache<Key, QImage> images;
+
+    static constexpr int MIN_SCALE_STEP = -5;
+    static constexpr qsizetype CACHE_COST_LIMIT = 16 * 1024 * 1024;
+};
+
+#endif // SYMBOLCACHE_H
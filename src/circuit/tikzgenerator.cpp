@@ -1,114 +1,161 @@
 #include "tikzgenerator.h"
 #include "circuitcanvas.h"
 #include "circuitelement.h"
-#include <QTextStream>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// Literal pieces of each element line, indexed by ElementType. A line is
+// emitted as <lead><coordinate><middle>[<label><tail>].
+struct ElementSyntax {
+    QLatin1String lead;
+    QLatin1String middle;
+    QLatin1String tail;
+};
+
+const ElementSyntax elementSyntax[] = {
+    { QLatin1String("\\draw "), QLatin1String(" to[R, l=$"), QLatin1String("$] ++(2,0);") },
+    { QLatin1String("\\draw "), QLatin1String(" to[C, l=$"), QLatin1String("$] ++(2,0);") },
+    { QLatin1String("\\draw "), QLatin1String(" to[L, l=$"), QLatin1String("$] ++(2,0);") },
+    { QLatin1String("\\draw "), QLatin1String(" to[V, l=$"), QLatin1String("$] ++(0,-2);") },
+    { QLatin1String("\\draw "), QLatin1String(" to[I, l=$"), QLatin1String("$] ++(0,-2);") },
+    { QLatin1String("\\node[ground] at "), QLatin1String(" {};"), QLatin1String() },
+    { QLatin1String("\\node[circ] at "), QLatin1String(" {};"), QLatin1String() },
+};
+
+const QLatin1String sectionTitles[] = {
+    QLatin1String("% Resistors\n"),
+    QLatin1String("% Capacitors\n"),
+    QLatin1String("% Inductors\n"),
+    QLatin1String("% Sources\n"),
+    QLatin1String("% Nodes\n"),
+    QLatin1String("% Ground connections\n"),
+};
+
+// Rough size of one emitted element line, used to presize the buffer.
+constexpr int ESTIMATED_LINE_LENGTH = 48;
+
+}
 
 TikzGenerator::TikzGenerator(QObject *parent)
     : QObject(parent)
+    , scannedLength(0)
+    , scannedLines(0)
 {
 }
 
-QString TikzGenerator::generateFromCanvas(CircuitCanvas *canvas)
+QString TikzGenerator::generateFromCanvas(CircuitCanvas *canvas, QList<quint64> *lineElementIds)
 {
     if (!canvas) {
+        if (lineElementIds) {
+            lineElementIds->clear();
+        }
         return generateHeader() + "\n" + generateFooter();
     }
     
-    QString tikzCode;
-    QTextStream stream(&tikzCode);
+    return generateFromSnapshot(canvas->snapshot(), lineElementIds);
+}
+
+QString TikzGenerator::generateFromSnapshot(const CircuitSnapshot &snapshot, QList<quint64> *lineElementIds)
+{
+    if (lineElementIds) {
+        lineElementIds->clear();
+    }
     
-    stream << generateHeader() << "\n";
+    QString buffer;
+    buffer.reserve(256 + snapshot.size() * ESTIMATED_LINE_LENGTH);
+    scannedLength = 0;
+    scannedLines = 0;
     
-    QList<CircuitElement*> elements = canvas->getElements();
+    buffer += generateHeader();
+    buffer += QLatin1Char('\n');
     
-    if (elements.isEmpty()) {
-        stream << "% No elements in circuit\n";
+    if (snapshot.isEmpty()) {
+        buffer += QLatin1String("% No elements in circuit\n");
     } else {
-        stream << "% Circuit elements\n";
+        buffer += QLatin1String("% Circuit elements\n");
         
-        QList<CircuitElement*> resistors, capacitors, inductors, sources, nodes, grounds;
+        for (auto &section : sections) {
+            section.clear();
+        }
         
-        for (auto element : elements) {
-            switch (element->getType()) {
+        snapshot.forEach([this](const ElementRecord &element) {
+            switch (element.type) {
                 case ElementType::Resistor:
-                    resistors.append(element);
+                    sections[Resistors].append(&element);
                     break;
                 case ElementType::Capacitor:
-                    capacitors.append(element);
+                    sections[Capacitors].append(&element);
                     break;
                 case ElementType::Inductor:
-                    inductors.append(element);
+                    sections[Inductors].append(&element);
                     break;
                 case ElementType::VoltageSource:
                 case ElementType::CurrentSource:
-                    sources.append(element);
+                    sections[Sources].append(&element);
                     break;
                 case ElementType::Node:
-                    nodes.append(element);
+                    sections[Nodes].append(&element);
                     break;
                 case ElementType::Ground:
-                    grounds.append(element);
+                    sections[Grounds].append(&element);
                     break;
             }
-        }
+        });
         
-        if (!resistors.isEmpty()) {
-            stream << "% Resistors\n";
-            for (auto resistor : resistors) {
-                stream << generateElementCode(resistor) << "\n";
+        for (int i = 0; i < SectionCount; ++i) {
+            if (sections[i].isEmpty()) {
+                continue;
             }
-            stream << "\n";
-        }
-        
-        if (!capacitors.isEmpty()) {
-            stream << "% Capacitors\n";
-            for (auto capacitor : capacitors) {
-                stream << generateElementCode(capacitor) << "\n";
+            buffer += sectionTitles[i];
+            for (auto element : sections[i]) {
+                if (lineElementIds) {
+                    recordLine(buffer, lineElementIds, element->id);
+                }
+                appendElementCode(buffer, element->type, element->pos, element->label);
+                buffer += QLatin1Char('\n');
             }
-            stream << "\n";
+            buffer += QLatin1Char('\n');
         }
         
-        if (!inductors.isEmpty()) {
-            stream << "% Inductors\n";
-            for (auto inductor : inductors) {
-                stream << generateElementCode(inductor) << "\n";
-            }
-            stream << "\n";
-        }
-        
-        if (!sources.isEmpty()) {
-            stream << "% Sources\n";
-            for (auto source : sources) {
-                stream << generateElementCode(source) << "\n";
-            }
-            stream << "\n";
-        }
-        
-        if (!nodes.isEmpty()) {
-            stream << "% Nodes\n";
-            for (auto node : nodes) {
-                stream << generateElementCode(node) << "\n";
-            }
-            stream << "\n";
-        }
-        
-        if (!grounds.isEmpty()) {
-            stream << "% Ground connections\n";
-            for (auto ground : grounds) {
-                stream << generateElementCode(ground) << "\n";
-            }
-            stream << "\n";
-        }
-        
-        if (elements.size() > 1) {
-            stream << "% Example connections (manually adjust as needed)\n";
-            stream << "% \\draw (0,0) to[R, l=$R_1$] (2,0) to[C, l=$C_1$] (4,0);\n";
+        if (snapshot.size() > 1) {
+            buffer += QLatin1String("% Example connections (manually adjust as needed)\n");
+            buffer += QLatin1String("% \\draw (0,0) to[R, l=$R_1$] (2,0) to[C, l=$C_1$] (4,0);\n");
         }
     }
     
-    stream << generateFooter();
+    buffer += generateFooter();
+    
+    if (lineElementIds) {
+        recordLine(buffer, lineElementIds, 0);
+    }
     
-    return tikzCode;
+    // Drop the record pointers, they belong to the caller's snapshot
+    for (auto &section : sections) {
+        section.clear();
+    }
+    
+    return buffer;
+}
+
+// Pads lineElementIds with structural lines up to the line currently being
+// written, then records id for it.
+void TikzGenerator::recordLine(const QString &buffer, QList<quint64> *lineElementIds, quint64 id)
+{
+    const QChar *text = buffer.constData();
+    for (qsizetype i = scannedLength; i < buffer.size(); ++i) {
+        if (text[i] == QLatin1Char('\n')) {
+            ++scannedLines;
+        }
+    }
+    scannedLength = buffer.size();
+    
+    while (lineElementIds->size() < scannedLines) {
+        lineElementIds->append(0);
+    }
+    lineElementIds->append(id);
 }
 
 QString TikzGenerator::generateHeader()
@@ -121,62 +168,59 @@ QString TikzGenerator::generateFooter()
     return QString("\\end{circuitikz}");
 }
 
-QString TikzGenerator::generateElementCode(CircuitElement *element)
+QString TikzGenerator::generateElementCode(ElementType type, const QPointF &scenePos, const QString &label)
 {
-    if (!element) {
-        return "";
-    }
+    QString code;
+    appendElementCode(code, type, scenePos, label);
+    return code;
+}
+
+void TikzGenerator::appendElementCode(QString &buffer, ElementType type, const QPointF &scenePos, const QString &label)
+{
+    const ElementSyntax &syntax = elementSyntax[static_cast<int>(type)];
     
-    QPointF pos = element->scenePos();
-    qreal x = pos.x() * GRID_TO_TIKZ_SCALE;
-    qreal y = -pos.y() * GRID_TO_TIKZ_SCALE;
+    buffer += syntax.lead;
+    appendCoordinate(buffer, scenePos.x() * GRID_TO_TIKZ_SCALE, -scenePos.y() * GRID_TO_TIKZ_SCALE);
+    buffer += syntax.middle;
     
-    QString label = element->getLabel();
-    if (label.isEmpty()) {
-        label = "?";
-    }
-    
-    switch (element->getType()) {
-        case ElementType::Resistor:
-            return QString("\\draw %1 to[R, l=$%2$] ++(2,0);")
-                   .arg(formatCoordinate(x, y))
-                   .arg(label);
-            
-        case ElementType::Capacitor:
-            return QString("\\draw %1 to[C, l=$%2$] ++(2,0);")
-                   .arg(formatCoordinate(x, y))
-                   .arg(label);
-            
-        case ElementType::Inductor:
-            return QString("\\draw %1 to[L, l=$%2$] ++(2,0);")
-                   .arg(formatCoordinate(x, y))
-                   .arg(label);
-            
-        case ElementType::VoltageSource:
-            return QString("\\draw %1 to[V, l=$%2$] ++(0,-2);")
-                   .arg(formatCoordinate(x, y))
-                   .arg(label);
-            
-        case ElementType::CurrentSource:
-            return QString("\\draw %1 to[I, l=$%2$] ++(0,-2);")
-                   .arg(formatCoordinate(x, y))
-                   .arg(label);
-            
-        case ElementType::Ground:
-            return QString("\\node[ground] at %1 {};")
-                   .arg(formatCoordinate(x, y));
-            
-        case ElementType::Node:
-            return QString("\\node[circ] at %1 {};")
-                   .arg(formatCoordinate(x, y));
-            
-        default:
-            return QString("% Unknown element at %1")
-                   .arg(formatCoordinate(x, y));
+    if (!syntax.tail.isEmpty()) {
+        if (label.isEmpty()) {
+            buffer += QLatin1Char('?');
+        } else {
+            buffer += label;
+        }
+        buffer += syntax.tail;
     }
 }
 
-QString TikzGenerator::formatCoordinate(qreal x, qreal y)
+void TikzGenerator::appendCoordinate(QString &buffer, qreal x, qreal y)
 {
-    return QString("(%1,%2)").arg(x, 0, 'f', 2).arg(y, 0, 'f', 2);
+    buffer += QLatin1Char('(');
+    appendFixed(buffer, x);
+    buffer += QLatin1Char(',');
+    appendFixed(buffer, y);
+    buffer += QLatin1Char(')');
+}
+
+// Writes value with exactly two decimals. Grid coordinates are multiples of
+// 0.05, so rounding to hundredths is exact and plain integer formatting
+// avoids the floating point conversion of QString::arg.
+void TikzGenerator::appendFixed(QString &buffer, qreal value)
+{
+    long long hundredths = std::llround(value * 100.0);
+    
+    char digits[32];
+    char *out = digits;
+    if (hundredths < 0) {
+        *out++ = '-';
+    }
+    unsigned long long magnitude = static_cast<unsigned long long>(std::llabs(hundredths));
+    
+    out = std::to_chars(out, digits + sizeof(digits) - 3, magnitude / 100).ptr;
+    unsigned fraction = static_cast<unsigned>(magnitude % 100);
+    *out++ = '.';
+    *out++ = static_cast<char>('0' + fraction / 10);
+    *out++ = static_cast<char>('0' + fraction % 10);
+    
+    buffer += QLatin1String(digits, static_cast<int>(out - digits));
 }
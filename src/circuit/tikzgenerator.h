@@ -4,9 +4,10 @@
 #include <QObject>
 #include <QString>
 #include <QList>
+#include <QPointF>
+#include "circuitsnapshot.h"
 
 class CircuitCanvas;
-class CircuitElement;
 
 class TikzGenerator : public QObject
 {
@@ -14,15 +15,32 @@ class TikzGenerator : public QObject
 
 public:
     explicit TikzGenerator(QObject *parent = nullptr);
+
+    // When lineElementIds is given it receives, for every output line, the id
+    // of the element emitted on it or 0 for structural lines.
+    QString generateFromCanvas(CircuitCanvas *canvas, QList<quint64> *lineElementIds = nullptr);
     
-    QString generateFromCanvas(CircuitCanvas *canvas);
+    // Reads nothing but the snapshot, so it may run on a worker thread as
+    // long as the generator itself is not shared between threads.
+    QString generateFromSnapshot(const CircuitSnapshot &snapshot, QList<quint64> *lineElementIds = nullptr);
     QString generateHeader();
     QString generateFooter();
 
+    QString generateElementCode(ElementType type, const QPointF &scenePos, const QString &label);
+
 private:
-    QString generateElementCode(CircuitElement *element);
-    QString formatCoordinate(qreal x, qreal y);
-    
+    static void appendElementCode(QString &buffer, ElementType type, const QPointF &scenePos, const QString &label);
+    static void appendCoordinate(QString &buffer, qreal x, qreal y);
+    static void appendFixed(QString &buffer, qreal value);
+    void recordLine(const QString &buffer, QList<quint64> *lineElementIds, quint64 id);
+
+    // How far recordLine has counted lines in the output being generated
+    qsizetype scannedLength;
+    qsizetype scannedLines;
+
+    enum Section { Resistors, Capacitors, Inductors, Sources, Nodes, Grounds, SectionCount };
+    QList<const ElementRecord*> sections[SectionCount];
+
     static constexpr qreal GRID_TO_TIKZ_SCALE = 0.05; // 20 pixels = 1 TikZ unit
 };
 
@@ -0,0 +1,65 @@
+#include "tikzparser.h"
+#include "circuitscene.h"
+#include <QRegularExpression>
+
+bool TikzParser::parseLine(const QString &line, ParsedElement *element)
+{
+    static const QRegularExpression drawPattern(
+        QStringLiteral("^\\s*\\\\draw\\s*\\(\\s*(-?[0-9.]+)\\s*,\\s*(-?[0-9.]+)\\s*\\)"
+                       "\\s*to\\[\\s*([RCLVI])\\s*(?:,\\s*l=\\$([^$]*)\\$)?\\s*\\]"));
+    static const QRegularExpression nodePattern(
+        QStringLiteral("^\\s*\\\\node\\[\\s*(ground|circ)\\s*\\]\\s*at"
+                       "\\s*\\(\\s*(-?[0-9.]+)\\s*,\\s*(-?[0-9.]+)\\s*\\)"));
+    
+    qreal x = 0;
+    qreal y = 0;
+    bool okX = false;
+    bool okY = false;
+    
+    QRegularExpressionMatch match = drawPattern.match(line);
+    if (match.hasMatch()) {
+        switch (match.capturedView(3).at(0).toLatin1()) {
+            case 'R':
+                element->type = ElementType::Resistor;
+                break;
+            case 'C':
+                element->type = ElementType::Capacitor;
+                break;
+            case 'L':
+                element->type = ElementType::Inductor;
+                break;
+            case 'V':
+                element->type = ElementType::VoltageSource;
+                break;
+            default:
+                element->type = ElementType::CurrentSource;
+                break;
+        }
+        x = match.capturedView(1).toDouble(&okX);
+        y = match.capturedView(2).toDouble(&okY);
+        // A line without l= leaves the element's label alone
+        element->hasLabel = match.hasCaptured(4);
+        element->label = match.captured(4);
+        if (element->label == QLatin1String("?")) {
+            element->label.clear();
+        }
+    } else {
+        match = nodePattern.match(line);
+        if (!match.hasMatch()) {
+            return false;
+        }
+        element->type = (match.capturedView(1) == QLatin1String("ground"))
+                        ? ElementType::Ground : ElementType::Node;
+        x = match.capturedView(2).toDouble(&okX);
+        y = match.capturedView(3).toDouble(&okY);
+        element->label.clear();
+        element->hasLabel = false;
+    }
+    
+    if (!okX || !okY) {
+        return false;
+    }
+    
+    element->scenePos = CircuitScene::snapToGrid(QPointF(x * TIKZ_TO_GRID_SCALE, -y * TIKZ_TO_GRID_SCALE));
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef TIKZPARSER_H
+#define TIKZPARSER_H
+
+#include <QString>
+#include <QPointF>
+#include "circuitelement.h"
+
+struct ParsedElement {
+    ElementType type = ElementType::Resistor;
+    QPointF scenePos;
+    QString label;
+    bool hasLabel = false;
+};
+
+// Reads back the single-line element statements written by TikzGenerator.
+// Lines it does not recognise (comments, wires, user additions) are left
+// alone by the caller.
+class TikzParser
+{
+public:
+    static bool parseLine(const QString &line, ParsedElement *element);
+
+private:
+    static constexpr qreal TIKZ_TO_GRID_SCALE = 20.0; // 1 TikZ unit = 20 pixels
+};
+
+#endif // TIKZPARSER_H
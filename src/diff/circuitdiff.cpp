@@ -0,0 +1,210 @@
+#include "circuitdiff.h"
+#include "regiontree.h"
+#include "../circuit/circuitsnapshot.h"
+#include "../circuit/tikzparser.h"
+#include <QFile>
+#include <QHash>
+#include <QMultiHash>
+#include <QPair>
+#include <QTextStream>
+
+CircuitDiff CircuitDiff::compare(const QList<ElementRecord> &before, const QList<ElementRecord> &after)
+{
+    CircuitDiff diff;
+    QList<ElementRecord> removed;
+    QList<ElementRecord> added;
+    RegionTree::diff(RegionTree(before), RegionTree(after), &removed, &added);
+    
+    // Pair removed and added elements of the same type and label as moves
+    QMultiHash<QPair<int, QString>, int> candidates;
+    for (int i = added.size() - 1; i >= 0; --i) {
+        candidates.insert(qMakePair(int(added.at(i).type), added.at(i).label), i);
+    }
+    
+    QVector<bool> taken(added.size(), false);
+    QList<ElementRecord> unpaired;
+    for (const ElementRecord &record : removed) {
+        auto it = candidates.find(qMakePair(int(record.type), record.label));
+        if (it == candidates.end()) {
+            unpaired.append(record);
+            continue;
+        }
+        taken[it.value()] = true;
+        diff.moved.append({ record, added.at(it.value()) });
+        candidates.erase(it);
+    }
+    
+    // Of the rest, elements of the same type in the same place were relabeled
+    QMultiHash<QPair<int, QPair<qreal, qreal>>, int> places;
+    for (int i = added.size() - 1; i >= 0; --i) {
+        if (!taken.at(i)) {
+            const ElementRecord &record = added.at(i);
+            places.insert(qMakePair(int(record.type), qMakePair(record.pos.x(), record.pos.y())), i);
+        }
+    }
+    for (const ElementRecord &record : unpaired) {
+        auto it = places.find(qMakePair(int(record.type), qMakePair(record.pos.x(), record.pos.y())));
+        if (it == places.end()) {
+            diff.removed.append(record);
+            continue;
+        }
+        taken[it.value()] = true;
+        diff.relabeled.append({ record, added.at(it.value()) });
+        places.erase(it);
+    }
+    
+    for (int i = 0; i < added.size(); ++i) {
+        if (!taken.at(i)) {
+            diff.added.append(added.at(i));
+        }
+    }
+    return diff;
+}
+
+QList<ElementRecord> CircuitDiff::records(const CircuitSnapshot &snapshot)
+{
+    QList<ElementRecord> list;
+    list.reserve(snapshot.size());
+    snapshot.forEach([&list](const ElementRecord &record) {
+        list.append(record);
+    });
+    return list;
+}
+
+// Reads the element lines of a saved circuit, the way they would be loaded
+// onto the canvas.
+bool CircuitDiff::readRevision(const QString &fileName, QList<ElementRecord> *records,
+                               QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    
+    QTextStream in(&file);
+    ParsedElement parsed;
+    while (!in.atEnd()) {
+        if (!TikzParser::parseLine(in.readLine(), &parsed)) {
+            continue;
+        }
+        ElementRecord record;
+        record.type = parsed.type;
+        record.pos = parsed.scenePos;
+        record.label = parsed.hasLabel ? parsed.label : CircuitElement::defaultLabel(parsed.type);
+        records->append(record);
+    }
+    return true;
+}
+
+CircuitMerge CircuitMerge::merge(const QList<ElementRecord> &base, const QList<ElementRecord> &ours,
+                                 const QList<ElementRecord> &theirs)
+{
+    const CircuitDiff mine = CircuitDiff::compare(base, ours);
+    const CircuitDiff other = CircuitDiff::compare(base, theirs);
+    
+    // What our side did to each base element it touched
+    QHash<quint64, const CircuitDiff::Move*> ourChanges;
+    QHash<quint64, const ElementRecord*> ourRemovals;
+    for (const QList<CircuitDiff::Move> *changes : { &mine.moved, &mine.relabeled }) {
+        for (const CircuitDiff::Move &change : *changes) {
+            ourChanges.insert(RegionTree::elementHash(change.from), &change);
+        }
+    }
+    for (const ElementRecord &record : mine.removed) {
+        ourRemovals.insert(RegionTree::elementHash(record), &record);
+    }
+    
+    // Start from ours, which already carries our changes, and mark the
+    // elements their side takes out
+    CircuitMerge merge;
+    QMultiHash<quint64, int> resultIndex;
+    for (int i = 0; i < ours.size(); ++i) {
+        resultIndex.insert(RegionTree::elementHash(ours.at(i)), i);
+    }
+    QVector<bool> dropped(ours.size(), false);
+    auto drop = [&](const ElementRecord &record) {
+        auto it = resultIndex.find(RegionTree::elementHash(record));
+        if (it != resultIndex.end()) {
+            dropped[it.value()] = true;
+            resultIndex.erase(it);
+        }
+    };
+    QList<ElementRecord> additions;
+    
+    for (const ElementRecord &record : other.removed) {
+        quint64 hash = RegionTree::elementHash(record);
+        if (ourRemovals.contains(hash)) {
+            continue;
+        }
+        if (ourChanges.contains(hash)) {
+            merge.conflicts.append({ record, ourChanges.value(hash)->to, ElementRecord(), false, true });
+            continue;
+        }
+        drop(record);
+    }
+    
+    auto takeChange = [&](const CircuitDiff::Move &change) {
+        quint64 hash = RegionTree::elementHash(change.from);
+        if (ourRemovals.contains(hash)) {
+            merge.conflicts.append({ change.from, ElementRecord(), change.to, true, false });
+            return;
+        }
+        auto ourChange = ourChanges.constFind(hash);
+        if (ourChange == ourChanges.cend()) {
+            drop(change.from);
+            additions.append(change.to);
+            return;
+        }
+        
+        // Both sides changed the element: position and label are merged
+        // separately and only clash when both set them to different values
+        const ElementRecord &mineTo = (*ourChange)->to;
+        ElementRecord combined = mineTo;
+        bool clash = false;
+        if (change.to.pos != change.from.pos) {
+            clash |= mineTo.pos != change.from.pos && mineTo.pos != change.to.pos;
+            combined.pos = change.to.pos;
+        }
+        if (change.to.label != change.from.label) {
+            clash |= mineTo.label != change.from.label && mineTo.label != change.to.label;
+            combined.label = change.to.label;
+        }
+        
+        if (clash) {
+            merge.conflicts.append({ change.from, mineTo, change.to, false, false });
+        } else if (RegionTree::elementHash(combined) != RegionTree::elementHash(mineTo)) {
+            drop(mineTo);
+            additions.append(combined);
+        }
+    };
+    for (const CircuitDiff::Move &move : other.moved) {
+        takeChange(move);
+    }
+    for (const CircuitDiff::Move &relabel : other.relabeled) {
+        takeChange(relabel);
+    }
+    
+    // Elements both sides added identically are only kept once
+    QHash<quint64, int> ourAdditions;
+    for (const ElementRecord &record : mine.added) {
+        ++ourAdditions[RegionTree::elementHash(record)];
+    }
+    for (const ElementRecord &record : other.added) {
+        auto it = ourAdditions.find(RegionTree::elementHash(record));
+        if (it != ourAdditions.end() && it.value() > 0) {
+            --it.value();
+        } else {
+            additions.append(record);
+        }
+    }
+    
+    merge.result.reserve(ours.size() + additions.size());
+    for (int i = 0; i < ours.size(); ++i) {
+        if (!dropped.at(i)) {
+            merge.result.append(ours.at(i));
+        }
+    }
+    merge.result += additions;
+    return merge;
+}
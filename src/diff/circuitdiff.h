@@ -0,0 +1,61 @@
+#ifndef CIRCUITDIFF_H
+#define CIRCUITDIFF_H
+
+#include <QList>
+#include <QString>
+#include "../circuit/circuitelement.h"
+
+class CircuitSnapshot;
+
+// Structural difference between two revisions of a circuit. Elements are
+// matched by content, not by line or id, so reordered TikZ output makes no
+// difference. An element that disappears in one place and shows up with the
+// same type and label in another counts as moved; one that keeps its type
+// and place but changes its label counts as relabeled.
+struct CircuitDiff
+{
+    struct Move {
+        ElementRecord from;
+        ElementRecord to;
+    };
+
+    QList<ElementRecord> added;
+    QList<ElementRecord> removed;
+    QList<Move> moved;
+    QList<Move> relabeled;
+
+    bool isEmpty() const
+    {
+        return added.isEmpty() && removed.isEmpty() && moved.isEmpty() && relabeled.isEmpty();
+    }
+
+    static CircuitDiff compare(const QList<ElementRecord> &before, const QList<ElementRecord> &after);
+
+    static QList<ElementRecord> records(const CircuitSnapshot &snapshot);
+    static bool readRevision(const QString &fileName, QList<ElementRecord> *records,
+                             QString *errorMessage);
+};
+
+// Three-way merge of two revisions against their common base. Changes made
+// on only one side are taken over, as are a move on one side and a relabel
+// on the other; an element moved or relabeled differently on both sides, or
+// changed on one and removed on the other, is a conflict and keeps our
+// version.
+struct CircuitMerge
+{
+    struct Conflict {
+        ElementRecord base;
+        ElementRecord ours;     // meaningless when removedInOurs
+        ElementRecord theirs;   // meaningless when removedInTheirs
+        bool removedInOurs;
+        bool removedInTheirs;
+    };
+
+    QList<ElementRecord> result;
+    QList<Conflict> conflicts;
+
+    static CircuitMerge merge(const QList<ElementRecord> &base, const QList<ElementRecord> &ours,
+                              const QList<ElementRecord> &theirs);
+};
+
+#endif // CIRCUITDIFF_H
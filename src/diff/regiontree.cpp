@@ -0,0 +1,131 @@
+#include "regiontree.h"
+#include <QSet>
+#include <cmath>
+
+RegionTree::RegionTree(const QList<ElementRecord> &records)
+    : records(records)
+    , levels(LEVELS)
+{
+    hashes.reserve(records.size());
+    
+    QHash<quint64, quint64> &leaves = levels[0];
+    for (int i = 0; i < records.size(); ++i) {
+        const ElementRecord &record = records.at(i);
+        quint64 hash = elementHash(record);
+        hashes.append(hash);
+        
+        int column = int(std::floor(record.pos.x() / LEAF_SIZE));
+        int row = int(std::floor(record.pos.y() / LEAF_SIZE));
+        quint64 key = regionKey(column, row);
+        leaves[key] += hash;
+        leafElements[key].append(i);
+    }
+    
+    // Each level only visits the regions that exist one level below
+    for (int level = 1; level < LEVELS; ++level) {
+        QHash<quint64, quint64> &parents = levels[level];
+        const QHash<quint64, quint64> &children = levels[level - 1];
+        for (auto it = children.cbegin(); it != children.cend(); ++it) {
+            int column = qint32(it.key() >> 32);
+            int row = qint32(it.key() & 0xffffffff);
+            // Arithmetic shifts round towards negative infinity, like floor
+            parents[regionKey(column >> 1, row >> 1)] += it.value();
+        }
+    }
+}
+
+quint64 RegionTree::regionKey(int column, int row)
+{
+    return (quint64(quint32(column)) << 32) | quint32(row);
+}
+
+// Position is taken in whole pixels; elements sit on the grid anyway.
+quint64 RegionTree::elementHash(const ElementRecord &record)
+{
+    quint64 hash = qHashMulti(0, int(record.type), record.label,
+                              qRound(record.pos.x()), qRound(record.pos.y()));
+    
+    // Finalize (splitmix64) so the sums over regions stay well distributed
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+void RegionTree::diff(const RegionTree &before, const RegionTree &after,
+                      QList<ElementRecord> *removed, QList<ElementRecord> *added)
+{
+    QSet<quint64> roots;
+    for (const RegionTree *tree : { &before, &after }) {
+        const QHash<quint64, quint64> &top = tree->levels.at(LEVELS - 1);
+        for (auto it = top.cbegin(); it != top.cend(); ++it) {
+            roots.insert(it.key());
+        }
+    }
+    
+    for (quint64 key : roots) {
+        before.compareRegion(after, LEVELS - 1, qint32(key >> 32), qint32(key & 0xffffffff),
+                             removed, added);
+    }
+}
+
+void RegionTree::compareRegion(const RegionTree &after, int level, int column, int row,
+                               QList<ElementRecord> *removed, QList<ElementRecord> *added) const
+{
+    const quint64 key = regionKey(column, row);
+    auto mine = levels.at(level).constFind(key);
+    auto theirs = after.levels.at(level).constFind(key);
+    bool hereMine = mine != levels.at(level).cend();
+    bool hereTheirs = theirs != after.levels.at(level).cend();
+    
+    if (!hereMine && !hereTheirs) {
+        return;
+    }
+    // Unchanged region, nothing below needs a look
+    if (hereMine && hereTheirs && mine.value() == theirs.value()) {
+        return;
+    }
+    
+    if (level == 0) {
+        compareLeaf(after, key, removed, added);
+        return;
+    }
+    
+    for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+            compareRegion(after, level - 1, 2 * column + dx, 2 * row + dy, removed, added);
+        }
+    }
+}
+
+// Multiset difference of the two leaves' elements by content hash
+void RegionTree::compareLeaf(const RegionTree &after, quint64 key,
+                             QList<ElementRecord> *removed, QList<ElementRecord> *added) const
+{
+    const QVector<int> mine = leafElements.value(key);
+    const QVector<int> theirs = after.leafElements.value(key);
+    
+    QHash<quint64, int> pending;
+    for (int i : mine) {
+        ++pending[hashes.at(i)];
+    }
+    
+    for (int i : theirs) {
+        auto it = pending.find(after.hashes.at(i));
+        if (it != pending.end() && it.value() > 0) {
+            --it.value();
+        } else {
+            added->append(after.records.at(i));
+        }
+    }
+    
+    for (int i : mine) {
+        auto it = pending.find(hashes.at(i));
+        if (it.value() > 0) {
+            --it.value();
+            removed->append(records.at(i));
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef REGIONTREE_H
+#define REGIONTREE_H
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include "../circuit/circuitelement.h"
+
+// Merkle tree over a fixed hierarchy of grid regions.
+//
+// Every element gets a content hash of its type, label and position. A
+// leaf region holds the sum of the hashes of its elements and each coarser
+// region the sum of its four children, so a region hash changes exactly
+// when something inside it changes (up to hash collisions). Because the
+// regions are aligned to the scene origin, two trees built from different
+// revisions share their region keys, and diff() skips every region whose
+// hashes match without looking inside.
+class RegionTree
+{
+public:
+    explicit RegionTree(const QList<ElementRecord> &records);
+
+    const QList<ElementRecord> &elements() const { return records; }
+
+    // Elements only in before go to removed, elements only in after to added
+    static void diff(const RegionTree &before, const RegionTree &after,
+                     QList<ElementRecord> *removed, QList<ElementRecord> *added);
+
+    static quint64 elementHash(const ElementRecord &record);
+
+private:
+    void compareRegion(const RegionTree &after, int level, int column, int row,
+                       QList<ElementRecord> *removed, QList<ElementRecord> *added) const;
+    void compareLeaf(const RegionTree &after, quint64 key,
+                     QList<ElementRecord> *removed, QList<ElementRecord> *added) const;
+
+    static quint64 regionKey(int column, int row);
+
+    QList<ElementRecord> records;
+    QVector<quint64> hashes;
+
+    // levels[0] are the leaf regions; leafElements lists their elements
+    QVector<QHash<quint64, quint64>> levels;
+    QHash<quint64, QVector<int>> leafElements;
+
+    static constexpr int LEAF_SIZE = 320;  // 16 grid cells
+    static constexpr int LEVELS = 16;
+};
+
+#endif // REGIONTREE_H
@@ -0,0 +1,109 @@
+#include "documenttab.h"
+#include "circuit/circuitcanvas.h"
+#include "editor/tikzcodeeditor.h"
+#include "editor/tikzsync.h"
+#include <QSplitter>
+#include <QVBoxLayout>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+DocumentTab::DocumentTab(TikzGenerator *generator, const QString &filePath, QWidget *parent)
+    : QWidget(parent)
+    , generator(generator)
+    , path(filePath)
+    , loaded(false)
+    , splitter(nullptr)
+    , canvasView(nullptr)
+    , codeEditor(nullptr)
+    , tikzSync(nullptr)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+}
+
+QString DocumentTab::title() const
+{
+    return path.isEmpty() ? QString("Untitled") : QFileInfo(path).fileName();
+}
+
+bool DocumentTab::activate(QString *errorMessage)
+{
+    prepare();
+    canvasView->restoreItems();
+    
+    if (!loaded) {
+        loaded = true;
+        return readFile(errorMessage);
+    }
+    return true;
+}
+
+void DocumentTab::deactivate()
+{
+    if (canvasView) {
+        canvasView->releaseItems();
+    }
+}
+
+void DocumentTab::prepare()
+{
+    if (splitter) {
+        return;
+    }
+    
+    // Create main splitter
+    splitter = new QSplitter(Qt::Horizontal, this);
+    
+    // Create circuit canvas
+    canvasView = new CircuitCanvas(this);
+    canvasView->setMinimumSize(600, 400);
+    
+    // Create TikZ code editor
+    codeEditor = new TikzCodeEditor(this);
+    codeEditor->setMinimumSize(300, 400);
+    codeEditor->setPlainText("% TikZ code will appear here\n\\begin{circuitikz}\n\n\\end{circuitikz}");
+    
+    // Add widgets to splitter
+    splitter->addWidget(canvasView);
+    splitter->addWidget(codeEditor);
+    splitter->setSizes({800, 400});
+    layout()->addWidget(splitter);
+    
+    // Keep canvas and TikZ code in sync in both directions
+    tikzSync = new TikzSync(canvasView, codeEditor, generator, this);
+}
+
+bool DocumentTab::readFile(QString *errorMessage)
+{
+    if (path.isEmpty()) {
+        return true;
+    }
+    
+    // An unreadable file leaves an untitled, empty document behind
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorMessage = file.errorString();
+        path.clear();
+        return false;
+    }
+    
+    // Element lines of the file are parsed onto the canvas on the way in
+    QTextStream in(&file);
+    codeEditor->setPlainText(in.readAll());
+    return true;
+}
+
+bool DocumentTab::save(const QString &fileName, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    
+    QTextStream out(&file);
+    out << codeEditor->toPlainText();
+    path = fileName;
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef DOCUMENTTAB_H
+#define DOCUMENTTAB_H
+
+#include <QWidget>
+#include <QString>
+
+class QSplitter;
+class CircuitCanvas;
+class TikzCodeEditor;
+class TikzGenerator;
+class TikzSync;
+
+// One open circuit: canvas, code view and their sync. Tabs are created
+// empty and build their widgets and read their file only when first
+// activated, so restoring a large session costs about as much as opening
+// a single file. Inactive tabs drop their scene items.
+//
+// prepare() builds just the widgets; at startup the window uses it to get
+// the first frame up before the file is read.
+class DocumentTab : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DocumentTab(TikzGenerator *generator, const QString &filePath = QString(),
+                         QWidget *parent = nullptr);
+
+    void prepare();
+    bool activate(QString *errorMessage);
+    void deactivate();
+    bool isLoaded() const { return loaded; }
+
+    bool save(const QString &fileName, QString *errorMessage);
+    QString filePath() const { return path; }
+    QString title() const;
+
+    CircuitCanvas *canvas() const { return canvasView; }
+    TikzCodeEditor *editor() const { return codeEditor; }
+    TikzSync *sync() const { return tikzSync; }
+
+private:
+    bool readFile(QString *errorMessage);
+
+    TikzGenerator *generator;
+    QString path;
+    bool loaded;
+
+    QSplitter *splitter;
+    CircuitCanvas *canvasView;
+    TikzCodeEditor *codeEditor;
+    TikzSync *tikzSync;
+};
+
+#endif // DOCUMENTTAB_H
@@ -0,0 +1,228 @@
+#include "tikzcodeeditor.h"
+#include "tikzhighlighter.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QFontDatabase>
+#include <QTextDocument>
+
+namespace {
+
+class CodeGutter : public QWidget
+{
+public:
+    explicit CodeGutter(TikzCodeEditor *editor)
+        : QWidget(editor)
+        , editor(editor)
+    {
+    }
+
+    QSize sizeHint() const override
+    {
+        return QSize(editor->gutterWidth(), 0);
+    }
+
+protected:
+    void paintEvent(QPaintEvent *event) override
+    {
+        editor->paintGutter(event);
+    }
+
+    void mousePressEvent(QMouseEvent *event) override
+    {
+        editor->gutterClicked(qRound(event->position().y()));
+    }
+
+private:
+    TikzCodeEditor *editor;
+};
+
+bool isSectionHeader(const QTextBlock &block)
+{
+    return block.text().startsWith(QLatin1String("% "));
+}
+
+// A section runs until the next empty line or the end of the environment
+bool endsSection(const QTextBlock &block)
+{
+    const QString text = block.text();
+    return text.trimmed().isEmpty() || text.startsWith(QLatin1String("\\end{"));
+}
+
+}
+
+TikzCodeEditor::TikzCodeEditor(QWidget *parent)
+    : QPlainTextEdit(parent)
+    , gutter(nullptr)
+    , highlighter(nullptr)
+    , highlightPending(false)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setLineWrapMode(QPlainTextEdit::NoWrap);
+    
+    gutter = new CodeGutter(this);
+    highlighter = new TikzHighlighter(document());
+    
+    connect(this, &QPlainTextEdit::blockCountChanged,
+            this, &TikzCodeEditor::updateGutterWidth);
+    connect(this, &QPlainTextEdit::updateRequest,
+            this, &TikzCodeEditor::onUpdateRequest);
+    connect(document(), &QTextDocument::contentsChange,
+            this, &TikzCodeEditor::onContentsChange);
+    
+    updateGutterWidth();
+}
+
+int TikzCodeEditor::gutterWidth() const
+{
+    int digits = 1;
+    int max = qMax(1, blockCount());
+    while (max >= 10) {
+        max /= 10;
+        ++digits;
+    }
+    
+    return 6 + fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits + FOLD_MARKER_WIDTH;
+}
+
+void TikzCodeEditor::updateGutterWidth()
+{
+    setViewportMargins(gutterWidth(), 0, 0, 0);
+}
+
+void TikzCodeEditor::resizeEvent(QResizeEvent *event)
+{
+    QPlainTextEdit::resizeEvent(event);
+    
+    QRect contents = contentsRect();
+    gutter->setGeometry(QRect(contents.left(), contents.top(), gutterWidth(), contents.height()));
+}
+
+void TikzCodeEditor::onUpdateRequest(const QRect &rect, int dy)
+{
+    if (dy) {
+        gutter->scroll(0, dy);
+    } else {
+        gutter->update(0, rect.y(), gutter->width(), rect.height());
+    }
+    
+    highlightVisibleBlocks();
+}
+
+// Text replaced by setPlainText or patched by TikzSync does not always
+// cause a viewport update, so visible blocks are rehighlighted after every
+// change as well. The pass waits for the event loop, by which time the
+// layout has caught up and a burst of edits costs a single pass.
+void TikzCodeEditor::onContentsChange()
+{
+    if (highlightPending) {
+        return;
+    }
+    highlightPending = true;
+    
+    QMetaObject::invokeMethod(this, [this]() {
+        highlightPending = false;
+        highlightVisibleBlocks();
+    }, Qt::QueuedConnection);
+}
+
+void TikzCodeEditor::highlightVisibleBlocks()
+{
+    QList<QTextBlock> visible;
+    
+    QTextBlock block = firstVisibleBlock();
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    const int bottom = viewport()->height();
+    
+    while (block.isValid() && top <= bottom) {
+        if (block.isVisible()) {
+            visible.append(block);
+            top += blockBoundingRect(block).height();
+        }
+        block = block.next();
+    }
+    
+    highlighter->ensureHighlighted(visible);
+}
+
+void TikzCodeEditor::paintGutter(QPaintEvent *event)
+{
+    QPainter painter(gutter);
+    painter.fillRect(event->rect(), QColor(240, 240, 240));
+    
+    QTextBlock block = firstVisibleBlock();
+    int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
+    const int lineHeight = fontMetrics().height();
+    const int numberWidth = gutter->width() - FOLD_MARKER_WIDTH - 3;
+    
+    while (block.isValid() && top <= event->rect().bottom()) {
+        if (block.isVisible()) {
+            int height = qRound(blockBoundingRect(block).height());
+            if (top + height >= event->rect().top()) {
+                painter.setPen(Qt::gray);
+                painter.drawText(0, top, numberWidth, lineHeight, Qt::AlignRight,
+                                 QString::number(block.blockNumber() + 1));
+                
+                if (isFoldable(block)) {
+                    painter.setPen(Qt::darkGray);
+                    painter.drawText(numberWidth + 3, top, FOLD_MARKER_WIDTH, lineHeight,
+                                     Qt::AlignCenter, isFolded(block) ? QStringLiteral("+") : QStringLiteral("-"));
+                }
+            }
+            top += height;
+        }
+        block = block.next();
+    }
+}
+
+void TikzCodeEditor::gutterClicked(int y)
+{
+    QTextBlock block = cursorForPosition(QPoint(0, y)).block();
+    if (isFoldable(block)) {
+        toggleFold(block);
+    }
+}
+
+bool TikzCodeEditor::isFoldable(const QTextBlock &block) const
+{
+    if (!isSectionHeader(block)) {
+        return false;
+    }
+    
+    QTextBlock next = block.next();
+    return next.isValid() && !endsSection(next) && !isSectionHeader(next);
+}
+
+bool TikzCodeEditor::isFolded(const QTextBlock &block) const
+{
+    QTextBlock next = block.next();
+    return next.isValid() && !next.isVisible();
+}
+
+void TikzCodeEditor::toggleFold(const QTextBlock &block)
+{
+    const bool show = isFolded(block);
+    
+    QTextBlock end = block.next();
+    while (end.isValid() && !endsSection(end)) {
+        end.setVisible(show);
+        end.setLineCount(show ? qMax(1, end.layout()->lineCount()) : 0);
+        end = end.next();
+    }
+    
+    const int start = block.next().position();
+    const int stop = end.isValid() ? end.position() : document()->characterCount();
+    document()->markContentsDirty(start, stop - start);
+    
+    // Keep the cursor out of hidden text
+    if (!show) {
+        QTextCursor cursor = textCursor();
+        if (cursor.position() >= start && cursor.position() < stop) {
+            cursor.setPosition(block.position());
+            setTextCursor(cursor);
+        }
+    }
+    
+    viewport()->update();
+    gutter->update();
+}
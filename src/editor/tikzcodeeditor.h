@@ -0,0 +1,44 @@
+#ifndef TIKZCODEEDITOR_H
+#define TIKZCODEEDITOR_H
+
+#include <QPlainTextEdit>
+#include <QTextBlock>
+
+class TikzHighlighter;
+
+// Plain-text TikZ view with line numbers, lazy highlighting and folding of
+// the commented sections emitted by TikzGenerator ("% Resistors", ...).
+class TikzCodeEditor : public QPlainTextEdit
+{
+    Q_OBJECT
+
+public:
+    explicit TikzCodeEditor(QWidget *parent = nullptr);
+
+    bool isFoldable(const QTextBlock &block) const;
+    bool isFolded(const QTextBlock &block) const;
+    void toggleFold(const QTextBlock &block);
+
+    int gutterWidth() const;
+    void paintGutter(QPaintEvent *event);
+    void gutterClicked(int y);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private slots:
+    void updateGutterWidth();
+    void onUpdateRequest(const QRect &rect, int dy);
+    void onContentsChange();
+
+private:
+    void highlightVisibleBlocks();
+
+    QWidget *gutter;
+    TikzHighlighter *highlighter;
+    bool highlightPending;
+
+    static constexpr int FOLD_MARKER_WIDTH = 12;
+};
+
+#endif // TIKZCODEEDITOR_H
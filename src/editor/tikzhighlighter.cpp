@@ -0,0 +1,134 @@
+#include "tikzhighlighter.h"
+#include <QTextDocument>
+
+TikzHighlighter::TikzHighlighter(QTextDocument *document)
+    : QObject(document)
+    , document(document)
+    , formatting(false)
+{
+    commandFormat.setForeground(QColor(0, 0, 160));
+    componentFormat.setForeground(QColor(160, 0, 160));
+    mathFormat.setForeground(QColor(0, 120, 0));
+    numberFormat.setForeground(QColor(170, 90, 0));
+    commentFormat.setForeground(Qt::gray);
+    commentFormat.setFontItalic(true);
+    
+    connect(document, &QTextDocument::contentsChange,
+            this, &TikzHighlighter::onContentsChange);
+}
+
+void TikzHighlighter::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved)
+    
+    if (formatting) {
+        return;
+    }
+    
+    // Only formats of the touched blocks become stale. Formatting itself
+    // happens later, and only for blocks that get scrolled into view.
+    QTextBlock block = document->findBlock(position);
+    QTextBlock last = document->findBlock(position + charsAdded);
+    while (block.isValid()) {
+        block.setUserState(-1);
+        if (block == last) {
+            break;
+        }
+        block = block.next();
+    }
+}
+
+void TikzHighlighter::ensureHighlighted(const QList<QTextBlock> &blocks)
+{
+    formatting = true;
+    
+    QList<QTextLayout::FormatRange> ranges;
+    for (QTextBlock block : blocks) {
+        if (!block.isValid() || block.userState() == BLOCK_HIGHLIGHTED) {
+            continue;
+        }
+        
+        ranges.clear();
+        formatLine(block.text(), ranges);
+        block.layout()->setFormats(ranges);
+        block.setUserState(BLOCK_HIGHLIGHTED);
+        document->markContentsDirty(block.position(), block.length());
+    }
+    
+    formatting = false;
+}
+
+void TikzHighlighter::addRange(QList<QTextLayout::FormatRange> &ranges, int start, int length,
+                               const QTextCharFormat &format) const
+{
+    QTextLayout::FormatRange range;
+    range.start = start;
+    range.length = length;
+    range.format = format;
+    ranges.append(range);
+}
+
+// CircuiTikZ lines carry no state across line breaks, so every block is
+// formatted from its own text alone.
+void TikzHighlighter::formatLine(const QString &text, QList<QTextLayout::FormatRange> &ranges) const
+{
+    const int n = text.size();
+    int i = 0;
+    
+    while (i < n) {
+        const QChar c = text.at(i);
+        
+        if (c == QLatin1Char('%')) {
+            addRange(ranges, i, n - i, commentFormat);
+            break;
+        }
+        
+        if (c == QLatin1Char('\\')) {
+            int j = i + 1;
+            while (j < n && text.at(j).isLetter()) {
+                ++j;
+            }
+            if (j == i + 1 && j < n) {
+                ++j;
+            }
+            addRange(ranges, i, j - i, commandFormat);
+            i = j;
+            continue;
+        }
+        
+        if (c == QLatin1Char('$')) {
+            int close = text.indexOf(QLatin1Char('$'), i + 1);
+            int end = (close < 0) ? n : close + 1;
+            addRange(ranges, i, end - i, mathFormat);
+            i = end;
+            continue;
+        }
+        
+        if (c == QLatin1Char('[')) {
+            // First key of an option list is the bipole or node shape
+            int j = i + 1;
+            while (j < n && text.at(j).isLetter()) {
+                ++j;
+            }
+            if (j > i + 1) {
+                addRange(ranges, i + 1, j - i - 1, componentFormat);
+            }
+            i = j;
+            continue;
+        }
+        
+        bool startsNumber = c.isDigit()
+            || ((c == QLatin1Char('-') || c == QLatin1Char('.')) && i + 1 < n && text.at(i + 1).isDigit());
+        if (startsNumber) {
+            int j = i + 1;
+            while (j < n && (text.at(j).isDigit() || text.at(j) == QLatin1Char('.'))) {
+                ++j;
+            }
+            addRange(ranges, i, j - i, numberFormat);
+            i = j;
+            continue;
+        }
+        
+        ++i;
+    }
+}
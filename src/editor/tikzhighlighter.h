@@ -0,0 +1,45 @@
+#ifndef TIKZHIGHLIGHTER_H
+#define TIKZHIGHLIGHTER_H
+
+#include <QObject>
+#include <QTextBlock>
+#include <QTextCharFormat>
+#include <QTextLayout>
+#include <QList>
+
+class QTextDocument;
+
+// Lazy CircuiTikZ highlighter. Unlike QSyntaxHighlighter it never walks the
+// whole document: edits only mark the touched blocks dirty, and blocks are
+// formatted when the editor asks for them, i.e. when they become visible.
+class TikzHighlighter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TikzHighlighter(QTextDocument *document);
+
+    void ensureHighlighted(const QList<QTextBlock> &blocks);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    void formatLine(const QString &text, QList<QTextLayout::FormatRange> &ranges) const;
+    void addRange(QList<QTextLayout::FormatRange> &ranges, int start, int length,
+                  const QTextCharFormat &format) const;
+
+    QTextDocument *document;
+    bool formatting;
+
+    QTextCharFormat commandFormat;
+    QTextCharFormat componentFormat;
+    QTextCharFormat mathFormat;
+    QTextCharFormat numberFormat;
+    QTextCharFormat commentFormat;
+
+    // Stored in QTextBlock::userState(); new blocks start at -1 (dirty).
+    static constexpr int BLOCK_HIGHLIGHTED = 1;
+};
+
+#endif // TIKZHIGHLIGHTER_H
@@ -0,0 +1,340 @@
+#include "tikzsync.h"
+#include "tikzcodeeditor.h"
+#include "../circuit/tikzgenerator.h"
+#include "../circuit/tikzparser.h"
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QPointer>
+#include <QHash>
+#include <algorithm>
+
+namespace {
+
+// Ties a line of TikZ code to the element generated from it. Deleting the
+// line deletes the data, which in turn removes the element. The data also
+// keeps the element's record as of the last sync, so a canvas change only
+// rewrites the lines whose element actually changed.
+class ElementBlockData : public QTextBlockUserData
+{
+public:
+    ElementBlockData(TikzSync *sync, const ElementRecord &record)
+        : sync(sync)
+        , id(record.id)
+        , synced(record)
+    {
+    }
+
+    ~ElementBlockData() override
+    {
+        if (sync) {
+            sync->elementLineRemoved(id);
+        }
+    }
+
+    quint64 elementId() const { return id; }
+    const ElementRecord &record() const { return synced; }
+    void setRecord(const ElementRecord &record) { synced = record; }
+
+    // Lets the data be deleted without removing its element, used when the
+    // id moves to another line.
+    void detach() { sync = nullptr; }
+
+private:
+    QPointer<TikzSync> sync;
+    quint64 id;
+    ElementRecord synced;
+};
+
+quint64 blockElementId(const QTextBlock &block)
+{
+    auto data = static_cast<ElementBlockData*>(block.userData());
+    return data ? data->elementId() : 0;
+}
+
+}
+
+TikzSync::TikzSync(CircuitCanvas *canvas, TikzCodeEditor *editor, TikzGenerator *generator,
+                   QObject *parent)
+    : QObject(parent)
+    , canvas(canvas)
+    , editor(editor)
+    , generator(generator)
+    , updatingText(false)
+    , textEdited(false)
+{
+    connect(editor->document(), &QTextDocument::contentsChange,
+            this, &TikzSync::onContentsChange);
+    connect(canvas, &CircuitCanvas::circuitChanged,
+            this, &TikzSync::onCircuitChanged);
+}
+
+void TikzSync::regenerate()
+{
+    updatingText = true;
+    
+    // The new text covers every change made so far
+    bool allChanged;
+    canvas->takeChangedElements(&allChanged);
+    
+    QString code = generator->generateFromCanvas(canvas, &lineElementIds);
+    editor->setPlainText(code);
+    blocksById.clear();
+    
+    QTextBlock block = editor->document()->firstBlock();
+    ElementRecord record;
+    for (quint64 id : lineElementIds) {
+        if (!block.isValid()) {
+            break;
+        }
+        if (id && canvas->elementRecord(id, &record)) {
+            block.setUserData(new ElementBlockData(this, record));
+            blocksById.insert(id, block);
+        }
+        block = block.next();
+    }
+    
+    updatingText = false;
+    textEdited = false;
+}
+
+void TikzSync::onCircuitChanged()
+{
+    if (textEdited) {
+        bool allChanged;
+        const QSet<quint64> changedIds = canvas->takeChangedElements(&allChanged);
+        patchText(changedIds, allChanged);
+    } else {
+        regenerate();
+    }
+}
+
+void TikzSync::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved)
+    
+    if (updatingText) {
+        return;
+    }
+    textEdited = true;
+    
+    struct EditedLine {
+        QTextBlock block;
+        bool parsed;
+        ParsedElement element;
+    };
+    QList<EditedLine> edited;
+    
+    QTextDocument *document = editor->document();
+    QTextBlock block = document->findBlock(position);
+    QTextBlock last = document->findBlock(position + charsAdded);
+    
+    while (block.isValid()) {
+        EditedLine line;
+        line.block = block;
+        line.parsed = TikzParser::parseLine(block.text(), &line.element);
+        edited.append(line);
+        if (block == last) {
+            break;
+        }
+        block = block.next();
+    }
+    
+    // Splitting a line leaves the element id on the upper half. If that half
+    // no longer holds an element statement, hand the id to a fresh line of
+    // the same type instead of creating a duplicate element.
+    QList<int> orphans;
+    for (int i = 0; i < edited.size(); ++i) {
+        if (!edited.at(i).parsed && canvas->hasElement(blockElementId(edited.at(i).block))) {
+            orphans.append(i);
+        }
+    }
+    
+    for (EditedLine &target : edited) {
+        if (orphans.isEmpty()) {
+            break;
+        }
+        if (!target.parsed || blockElementId(target.block)) {
+            continue;
+        }
+        for (int i = 0; i < orphans.size(); ++i) {
+            QTextBlock orphan = edited.at(orphans.at(i)).block;
+            auto data = static_cast<ElementBlockData*>(orphan.userData());
+            if (data->record().type != target.element.type) {
+                continue;
+            }
+            ElementRecord record = data->record();
+            data->detach();
+            orphan.setUserData(nullptr);
+            target.block.setUserData(new ElementBlockData(this, record));
+            blocksById.insert(record.id, target.block);
+            orphans.removeAt(i);
+            break;
+        }
+    }
+    
+    for (const EditedLine &line : edited) {
+        if (line.parsed) {
+            syncBlock(line.block, line.element);
+        }
+    }
+}
+
+void TikzSync::syncBlock(QTextBlock block, const ParsedElement &parsed)
+{
+    ElementRecord record;
+    bool exists = canvas->elementRecord(blockElementId(block), &record);
+    if (exists && record.type != parsed.type) {
+        canvas->removeElement(record.id);
+        exists = false;
+    }
+    
+    if (!exists) {
+        quint64 id = canvas->addElement(parsed.type, parsed.scenePos);
+        canvas->elementRecord(id, &record);
+        block.setUserData(new ElementBlockData(this, record));
+        blocksById.insert(id, block);
+    } else if (record.pos != parsed.scenePos) {
+        canvas->moveElement(record.id, parsed.scenePos);
+    }
+    
+    if (parsed.hasLabel && record.label != parsed.label) {
+        canvas->relabelElement(record.id, parsed.label);
+    }
+    
+    // The line now stands for the element as it is on the canvas
+    canvas->elementRecord(record.id, &record);
+    static_cast<ElementBlockData*>(block.userData())->setRecord(record);
+}
+
+void TikzSync::elementLineRemoved(quint64 id)
+{
+    blocksById.remove(id);
+    if (updatingText || !canvas) {
+        return;
+    }
+    canvas->removeElement(id);
+}
+
+// Brings a user-edited document up to date with the canvas without
+// replacing it. Only the lines of elements the canvas reports as changed
+// are visited: rewritten in place if the element differs from the line,
+// dropped if the element is gone, and inserted before \end for new
+// elements. Lines of unchanged elements keep whatever formatting and extra
+// options the user gave them.
+void TikzSync::patchText(const QSet<quint64> &changedIds, bool allChanged)
+{
+    bool rescanned = false;
+    QList<quint64> ids;
+    if (allChanged) {
+        indexBlocks();
+        rescanned = true;
+        ids = blocksById.keys();
+        canvas->snapshot().forEach([&ids](const ElementRecord &element) {
+            ids.append(element.id);
+        });
+    } else {
+        ids = QList<quint64>(changedIds.cbegin(), changedIds.cend());
+    }
+    // Ids grow with creation, so new lines keep the order of the circuit
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    
+    if (ids.isEmpty()) {
+        return;
+    }
+    updatingText = true;
+    
+    QTextDocument *document = editor->document();
+    QTextBlock endBlock = document->lastBlock();
+    while (endBlock.isValid() && !endBlock.text().startsWith(QLatin1String("\\end{circuitikz}"))) {
+        endBlock = endBlock.previous();
+    }
+    
+    QList<QTextBlock> staleBlocks;
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    
+    ElementRecord element;
+    for (quint64 id : ids) {
+        QTextBlock block = elementBlock(id, &rescanned);
+        
+        if (!canvas->elementRecord(id, &element)) {
+            if (block.isValid()) {
+                staleBlocks.append(block);
+            }
+            blocksById.remove(id);
+        } else if (block.isValid()) {
+            auto data = static_cast<ElementBlockData*>(block.userData());
+            const ElementRecord &synced = data->record();
+            if (synced.type != element.type || synced.pos != element.pos
+                || synced.label != element.label) {
+                cursor.setPosition(block.position());
+                cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+                cursor.insertText(generator->generateElementCode(element.type, element.pos, element.label));
+                data->setRecord(element);
+            }
+        } else {
+            QString line = generator->generateElementCode(element.type, element.pos, element.label);
+            // A split keeps the block data on the upper half, so new lines
+            // are always inserted as the lower half of a split.
+            if (endBlock.isValid() && endBlock.previous().isValid()) {
+                cursor.setPosition(endBlock.previous().position());
+                cursor.movePosition(QTextCursor::EndOfBlock);
+            } else {
+                cursor.movePosition(QTextCursor::End);
+            }
+            cursor.insertText(QLatin1Char('\n') + line);
+            cursor.block().setUserData(new ElementBlockData(this, element));
+            blocksById.insert(id, cursor.block());
+        }
+    }
+    
+    // Merging keeps the data of the upper block, so a stale line is removed
+    // together with the line break in front of it, bottom line first.
+    std::sort(staleBlocks.begin(), staleBlocks.end(), [](const QTextBlock &a, const QTextBlock &b) {
+        return a.position() > b.position();
+    });
+    for (const QTextBlock &stale : staleBlocks) {
+        if (stale.position() > 0) {
+            cursor.setPosition(stale.position() - 1);
+            cursor.setPosition(stale.position() + stale.length() - 1, QTextCursor::KeepAnchor);
+        } else {
+            cursor.setPosition(stale.position());
+            cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
+        }
+        cursor.removeSelectedText();
+    }
+    
+    cursor.endEditBlock();
+    updatingText = false;
+}
+
+// Line holding the element id, or an invalid block if there is none. An
+// entry that no longer matches its block makes the map be rebuilt, at most
+// once per patch.
+QTextBlock TikzSync::elementBlock(quint64 id, bool *rescanned)
+{
+    auto it = blocksById.constFind(id);
+    if (it == blocksById.cend()) {
+        return QTextBlock();
+    }
+    if (it->isValid() && blockElementId(*it) == id) {
+        return *it;
+    }
+    if (!*rescanned) {
+        indexBlocks();
+        *rescanned = true;
+        return blocksById.value(id);
+    }
+    return QTextBlock();
+}
+
+void TikzSync::indexBlocks()
+{
+    blocksById.clear();
+    for (QTextBlock block = editor->document()->firstBlock(); block.isValid(); block = block.next()) {
+        if (quint64 id = blockElementId(block)) {
+            blocksById.insert(id, block);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef TIKZSYNC_H
+#define TIKZSYNC_H
+
+#include <QObject>
+#include <QTextBlock>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QSet>
+#include "../circuit/circuitcanvas.h"
+
+class TikzCodeEditor;
+class TikzGenerator;
+struct ParsedElement;
+
+// Keeps a canvas and its TikZ code view in sync in both directions.
+//
+// Every generated element line carries the id of its element as
+// block user data, so the mapping survives insertions and deletions around
+// it. Text edits only reparse the blocks they touch and create, move,
+// relabel or delete the matching elements. Canvas changes regenerate the
+// whole text while it is untouched, and patch the lines of the elements
+// the canvas reports as changed once the user has edited it so their
+// additions are kept.
+class TikzSync : public QObject
+{
+    Q_OBJECT
+
+public:
+    TikzSync(CircuitCanvas *canvas, TikzCodeEditor *editor, TikzGenerator *generator,
+             QObject *parent = nullptr);
+
+    void elementLineRemoved(quint64 id);
+    
+    // True while the text is changed on behalf of the canvas
+    bool isUpdatingText() const { return updatingText; }
+
+public slots:
+    void regenerate();
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void onCircuitChanged();
+
+private:
+    void syncBlock(QTextBlock block, const ParsedElement &parsed);
+    void patchText(const QSet<quint64> &changedIds, bool allChanged);
+    QTextBlock elementBlock(quint64 id, bool *rescanned);
+    void indexBlocks();
+
+    QPointer<CircuitCanvas> canvas;
+    TikzCodeEditor *editor;
+    TikzGenerator *generator;
+    QList<quint64> lineElementIds;
+    
+    // Line of each element id as last seen. Splitting and merging lines can
+    // leave an entry pointing elsewhere, so lookups check the block data.
+    QHash<quint64, QTextBlock> blocksById;
+
+    bool updatingText;
+    bool textEdited;
+};
+
+#endif // TIKZSYNC_H
@@ -0,0 +1,243 @@
+#include "imageexporter.h"
+#include "pngstreamwriter.h"
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QSemaphore>
+#include <QSvgGenerator>
+#include <QThread>
+#include <QThreadPool>
+#include <QtMath>
+#include <cmath>
+
+ImageExporter::ImageExporter(const CircuitSnapshot &snapshot)
+    : snapshot(snapshot)
+{
+    const QRectF symbol = CircuitElement::symbolRect();
+    elements.reserve(snapshot.size());
+    this->snapshot.forEach([&](const ElementRecord &element) {
+        elements.append(&element);
+        bounds |= symbol.translated(element.pos);
+    });
+    if (!bounds.isEmpty()) {
+        bounds.adjust(-MARGIN, -MARGIN, MARGIN, MARGIN);
+    }
+}
+
+QSize ImageExporter::imageSize(int dpi, QString *errorMessage) const
+{
+    const qreal scale = dpi / SCENE_DPI;
+    const double width = std::ceil(bounds.width() * scale);
+    const double height = std::ceil(bounds.height() * scale);
+    
+    // Compared as doubles first, so a huge extent cannot wrap the integers
+    if (width > double(MAX_IMAGE_WIDTH) || height > double(MAX_IMAGE_HEIGHT)) {
+        if (errorMessage) {
+            *errorMessage = QStringLiteral("The image would be %1x%2 pixels, more than can be "
+                                           "exported (at most %3x%4); choose a lower resolution")
+                                .arg(qint64(width)).arg(qint64(height))
+                                .arg(MAX_IMAGE_WIDTH).arg(MAX_IMAGE_HEIGHT);
+        }
+        return QSize();
+    }
+    
+    const qint64 columns = (qint64(width) + TILE_SIZE - 1) / TILE_SIZE;
+    const qint64 rows = (qint64(height) + TILE_SIZE - 1) / TILE_SIZE;
+    if (columns * rows > MAX_TILE_COUNT) {
+        if (errorMessage) {
+            *errorMessage = QStringLiteral("The image would be %1x%2 pixels, too large to export; "
+                                           "choose a lower resolution")
+                                .arg(qint64(width)).arg(qint64(height));
+        }
+        return QSize();
+    }
+    
+    return QSize(int(width), int(height));
+}
+
+// Assigns every element to the output tiles its symbol overlaps, so a tile
+// only looks at elements that can actually show up in it.
+QVector<QVector<int>> ImageExporter::bucketByTile(qreal scale, int columns, int rows) const
+{
+    QVector<QVector<int>> buckets(columns * rows);
+    const QRectF symbol = CircuitElement::symbolRect();
+    
+    for (int i = 0; i < elements.size(); ++i) {
+        QRectF rect = symbol.translated(elements.at(i)->pos).translated(-bounds.topLeft());
+        int firstColumn = qBound(0, int(std::floor(rect.left() * scale / TILE_SIZE)), columns - 1);
+        int lastColumn = qBound(0, int(std::floor(rect.right() * scale / TILE_SIZE)), columns - 1);
+        int firstRow = qBound(0, int(std::floor(rect.top() * scale / TILE_SIZE)), rows - 1);
+        int lastRow = qBound(0, int(std::floor(rect.bottom() * scale / TILE_SIZE)), rows - 1);
+        
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                buckets[row * columns + column].append(i);
+            }
+        }
+    }
+    
+    return buckets;
+}
+
+void ImageExporter::renderElements(QPainter *painter, const QVector<int> &indices) const
+{
+    for (int index : indices) {
+        const ElementRecord &element = *elements.at(index);
+        painter->save();
+        painter->translate(element.pos);
+        CircuitElement::drawSymbol(painter, element.type, element.label, false);
+        painter->restore();
+    }
+}
+
+// The image is produced in bands one tile high. The tiles of a band are
+// rendered in parallel, each worker with its own QImage (a view onto the
+// band's rows) and QPainter, while the previous band is compressed. Memory
+// use is therefore two bands, independent of the image height.
+bool ImageExporter::exportPng(const QString &fileName, int dpi, QString *errorMessage) const
+{
+    if (bounds.isEmpty()) {
+        *errorMessage = QStringLiteral("The circuit is empty");
+        return false;
+    }
+    
+    const qreal scale = dpi / SCENE_DPI;
+    const QSize size = imageSize(dpi, errorMessage);
+    if (size.isEmpty()) {
+        return false;
+    }
+    const int columns = (size.width() + TILE_SIZE - 1) / TILE_SIZE;
+    const int rows = (size.height() + TILE_SIZE - 1) / TILE_SIZE;
+    
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    
+    PngStreamWriter writer(&file);
+    if (!writer.begin(size.width(), size.height(), dpi)) {
+        *errorMessage = QStringLiteral("Could not write PNG header");
+        return false;
+    }
+    
+    const QVector<QVector<int>> buckets = bucketByTile(scale, columns, rows);
+    
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    
+    QImage bands[2];
+    QSemaphore finished[2];
+    
+    // Returns false when the band buffer cannot be allocated
+    auto startBand = [&](int row) {
+        QImage &band = bands[row % 2];
+        if (band.isNull()) {
+            band = QImage(size.width(), TILE_SIZE, QImage::Format_RGB32);
+            if (band.isNull()) {
+                return false;
+            }
+        }
+        uchar *bits = band.bits();
+        const qsizetype bytesPerLine = band.bytesPerLine();
+        QSemaphore *done = &finished[row % 2];
+        
+        for (int column = 0; column < columns; ++column) {
+            const QVector<int> *candidates = &buckets.at(row * columns + column);
+            pool.start([=]() {
+                const int x = column * TILE_SIZE;
+                const int width = qMin(TILE_SIZE, size.width() - x);
+                QImage tile(bits + x * 4, width, TILE_SIZE, bytesPerLine, QImage::Format_RGB32);
+                tile.fill(Qt::white);
+                
+                QPainter painter(&tile);
+                painter.setRenderHint(QPainter::Antialiasing);
+                painter.scale(scale, scale);
+                QPointF origin = bounds.topLeft() + QPointF(x, row * TILE_SIZE) / scale;
+                painter.translate(-origin);
+                renderElements(&painter, *candidates);
+                painter.end();
+                
+                done->release();
+            });
+        }
+        return true;
+    };
+    
+    auto outOfMemory = [&]() {
+        *errorMessage = QStringLiteral("Not enough memory for a %1x%2 pixel band; "
+                                       "choose a lower resolution")
+                            .arg(size.width()).arg(TILE_SIZE);
+        return false;
+    };
+    
+    if (!startBand(0)) {
+        return outOfMemory();
+    }
+    
+    bool ok = true;
+    bool allocated = true;
+    for (int row = 0; row < rows; ++row) {
+        finished[row % 2].acquire(columns);
+        
+        // Band row + 1 reuses the buffer of band row - 1, which is written out
+        if (row + 1 < rows && !startBand(row + 1)) {
+            allocated = false;
+            break;
+        }
+        
+        if (ok) {
+            int rowCount = qMin(TILE_SIZE, size.height() - row * TILE_SIZE);
+            ok = writer.writeRows(bands[row % 2], rowCount);
+        }
+    }
+    pool.waitForDone();
+    
+    // The file is left incomplete; no PNG end chunk is written
+    if (!allocated) {
+        return outOfMemory();
+    }
+    if (!ok || !writer.finish()) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    
+    return true;
+}
+
+bool ImageExporter::exportSvg(const QString &fileName, int dpi, QString *errorMessage) const
+{
+    if (bounds.isEmpty()) {
+        *errorMessage = QStringLiteral("The circuit is empty");
+        return false;
+    }
+    
+    const QSize size = imageSize(dpi, errorMessage);
+    if (size.isEmpty()) {
+        return false;
+    }
+    
+    // Not streamed: QSvgGenerator keeps the whole document in memory and
+    // only writes it to the file in end(), so memory grows with the circuit
+    QSvgGenerator generator;
+    generator.setFileName(fileName);
+    generator.setSize(size);
+    generator.setViewBox(QRectF(QPointF(0, 0), bounds.size()));
+    generator.setResolution(dpi);
+    generator.setTitle(QStringLiteral("CircuiTikZ Editor export"));
+    
+    QPainter painter;
+    if (!painter.begin(&generator)) {
+        *errorMessage = QStringLiteral("Could not write %1").arg(fileName);
+        return false;
+    }
+    painter.translate(-bounds.topLeft());
+    
+    QVector<int> all(elements.size());
+    for (int i = 0; i < all.size(); ++i) {
+        all[i] = i;
+    }
+    renderElements(&painter, all);
+    
+    return painter.end();
+}
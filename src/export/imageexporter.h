@@ -0,0 +1,56 @@
+#ifndef IMAGEEXPORTER_H
+#define IMAGEEXPORTER_H
+
+#include <QList>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <limits>
+#include "../circuit/circuitsnapshot.h"
+
+class QPainter;
+
+// Renders a circuit to PNG or SVG without going through LaTeX. Works on an
+// immutable snapshot only, never on the live scene, so it can run on a
+// background thread and render PNG tiles on worker threads.
+class ImageExporter
+{
+public:
+    explicit ImageExporter(const CircuitSnapshot &snapshot);
+
+    // PNG is encoded band by band while the tiles are rendered. SVG is built
+    // in memory by QSvgGenerator and written out at the end.
+    bool exportPng(const QString &fileName, int dpi, QString *errorMessage) const;
+    bool exportSvg(const QString &fileName, int dpi, QString *errorMessage) const;
+
+    QRectF sceneBounds() const { return bounds; }
+    
+    // Pixel size of the image at dpi. Empty, with errorMessage set, when the
+    // image would exceed what the exporters can encode.
+    QSize imageSize(int dpi, QString *errorMessage = nullptr) const;
+
+private:
+    void renderElements(QPainter *painter, const QVector<int> &indices) const;
+    QVector<QVector<int>> bucketByTile(qreal scale, int columns, int rows) const;
+
+    // The snapshot keeps the records alive; elements points into it and
+    // gives tiles indexed access
+    CircuitSnapshot snapshot;
+    QVector<const ElementRecord*> elements;
+    QRectF bounds;
+
+    static constexpr int TILE_SIZE = 512;
+    static constexpr qreal SCENE_DPI = 96.0;
+    static constexpr qreal MARGIN = 20.0;
+    
+    // PNG dimensions are limited to 2^31 - 1; a band row is one QImage
+    // scanline (4 bytes a pixel) and one zlib input buffer (3 bytes plus the
+    // filter byte), both sized in int. The tile count bounds the per-tile
+    // element buckets.
+    static constexpr qint64 MAX_IMAGE_WIDTH = (std::numeric_limits<int>::max() - 1) / 4;
+    static constexpr qint64 MAX_IMAGE_HEIGHT = std::numeric_limits<int>::max();
+    static constexpr qint64 MAX_TILE_COUNT = qint64(1) << 22;
+};
+
+#endif // IMAGEEXPORTER_H
@@ -0,0 +1,167 @@
+#include "pngstreamwriter.h"
+#include <QIODevice>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+void appendBigEndian(QByteArray &data, quint32 value)
+{
+    char bytes[4];
+    qToBigEndian(value, bytes);
+    data.append(bytes, 4);
+}
+
+}
+
+PngStreamWriter::PngStreamWriter(QIODevice *device)
+    : device(device)
+    , streamActive(false)
+    , imageWidth(0)
+    , imageHeight(0)
+    , rowsWritten(0)
+{
+    std::memset(&stream, 0, sizeof(stream));
+}
+
+PngStreamWriter::~PngStreamWriter()
+{
+    if (streamActive) {
+        deflateEnd(&stream);
+    }
+}
+
+bool PngStreamWriter::begin(int width, int height, int dpi)
+{
+    static const char signature[] = { char(0x89), 'P', 'N', 'G', '\r', '\n', char(0x1a), '\n' };
+    if (device->write(signature, sizeof(signature)) != qint64(sizeof(signature))) {
+        return false;
+    }
+    
+    QByteArray header;
+    appendBigEndian(header, quint32(width));
+    appendBigEndian(header, quint32(height));
+    header.append(char(8));   // bit depth
+    header.append(char(2));   // color type: RGB
+    header.append(char(0));   // compression
+    header.append(char(0));   // filter
+    header.append(char(0));   // interlace
+    if (!writeChunk("IHDR", header)) {
+        return false;
+    }
+    
+    QByteArray physical;
+    quint32 pixelsPerMeter = quint32(dpi / 0.0254 + 0.5);
+    appendBigEndian(physical, pixelsPerMeter);
+    appendBigEndian(physical, pixelsPerMeter);
+    physical.append(char(1)); // unit: meter
+    if (!writeChunk("pHYs", physical)) {
+        return false;
+    }
+    
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return false;
+    }
+    streamActive = true;
+    
+    imageWidth = width;
+    imageHeight = height;
+    rowsWritten = 0;
+    rowBuffer.resize(1 + 3 * width);
+    outBuffer.resize(IDAT_CHUNK_SIZE);
+    stream.next_out = reinterpret_cast<Bytef*>(outBuffer.data());
+    stream.avail_out = uInt(outBuffer.size());
+    
+    return true;
+}
+
+// Appends the first rowCount rows of band, which must be Format_RGB32 and
+// exactly as wide as the image.
+bool PngStreamWriter::writeRows(const QImage &band, int rowCount)
+{
+    if (!streamActive || band.width() != imageWidth || band.format() != QImage::Format_RGB32) {
+        return false;
+    }
+    
+    for (int y = 0; y < rowCount && rowsWritten < imageHeight; ++y, ++rowsWritten) {
+        const QRgb *source = reinterpret_cast<const QRgb*>(band.constScanLine(y));
+        uchar *target = reinterpret_cast<uchar*>(rowBuffer.data());
+        *target++ = 0; // filter type: none
+        for (int x = 0; x < imageWidth; ++x) {
+            *target++ = uchar(qRed(source[x]));
+            *target++ = uchar(qGreen(source[x]));
+            *target++ = uchar(qBlue(source[x]));
+        }
+        
+        stream.next_in = reinterpret_cast<Bytef*>(rowBuffer.data());
+        stream.avail_in = uInt(rowBuffer.size());
+        if (!deflateInput(Z_NO_FLUSH)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool PngStreamWriter::finish()
+{
+    if (!streamActive || rowsWritten != imageHeight) {
+        return false;
+    }
+    
+    stream.next_in = nullptr;
+    stream.avail_in = 0;
+    if (!deflateInput(Z_FINISH)) {
+        return false;
+    }
+    
+    deflateEnd(&stream);
+    streamActive = false;
+    
+    return writeChunk("IEND", QByteArray());
+}
+
+// Feeds the pending input to zlib and writes every full output buffer as
+// an IDAT chunk. With Z_FINISH the remaining output is flushed as well.
+bool PngStreamWriter::deflateInput(int flush)
+{
+    for (;;) {
+        int result = deflate(&stream, flush);
+        if (result == Z_STREAM_ERROR) {
+            return false;
+        }
+        
+        bool bufferFull = stream.avail_out == 0;
+        bool finished = (flush == Z_FINISH && result == Z_STREAM_END);
+        if (bufferFull || finished) {
+            int produced = outBuffer.size() - int(stream.avail_out);
+            if (produced > 0 && !writeChunk("IDAT", outBuffer.left(produced))) {
+                return false;
+            }
+            stream.next_out = reinterpret_cast<Bytef*>(outBuffer.data());
+            stream.avail_out = uInt(outBuffer.size());
+        }
+        
+        if (finished) {
+            return true;
+        }
+        if (flush != Z_FINISH && stream.avail_in == 0 && !bufferFull) {
+            return true;
+        }
+    }
+}
+
+bool PngStreamWriter::writeChunk(const char *type, const QByteArray &data)
+{
+    QByteArray chunk;
+    chunk.reserve(12 + data.size());
+    appendBigEndian(chunk, quint32(data.size()));
+    chunk.append(type, 4);
+    chunk.append(data);
+    
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.constData() + 4), uInt(4 + data.size()));
+    appendBigEndian(chunk, quint32(crc));
+    
+    return device->write(chunk) == chunk.size();
+}
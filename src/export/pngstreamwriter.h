@@ -0,0 +1,39 @@
+#ifndef PNGSTREAMWRITER_H
+#define PNGSTREAMWRITER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <zlib.h>
+
+class QIODevice;
+
+// Writes an RGB PNG row band by row band, so an image of any height can be
+// encoded without ever holding it in memory as a whole. QImageWriter needs
+// the complete QImage up front, which rules it out for very large exports.
+class PngStreamWriter
+{
+public:
+    explicit PngStreamWriter(QIODevice *device);
+    ~PngStreamWriter();
+
+    bool begin(int width, int height, int dpi);
+    bool writeRows(const QImage &band, int rowCount);
+    bool finish();
+
+private:
+    bool writeChunk(const char *type, const QByteArray &data);
+    bool deflateInput(int flush);
+
+    QIODevice *device;
+    z_stream stream;
+    bool streamActive;
+    int imageWidth;
+    int imageHeight;
+    int rowsWritten;
+    QByteArray rowBuffer;
+    QByteArray outBuffer;
+
+    static constexpr int IDAT_CHUNK_SIZE = 1 << 16;
+};
+
+#endif // PNGSTREAMWRITER_H
@@ -0,0 +1,34 @@
+#include "headlessmodes.h"
+#include "mainwindow.h"
+#include "trace/inputreplayer.h"
+#include <QCoreApplication>
+#include <QTextStream>
+#include <memory>
+
+int runReplay(MainWindow *window, const QString &fileName)
+{
+    InputReplayer replayer(window);
+    QString error;
+    if (!replayer.load(fileName, &error)) {
+        QTextStream(stderr) << "Could not load trace: " << error << Qt::endl;
+        return 1;
+    }
+    replayer.run();
+    QTextStream(stdout) << replayer.report();
+    return 0;
+}
+
+void runStartupBenchmark(MainWindow *window, const QElapsedTimer *startup, qint64 budgetMs)
+{
+    auto firstFrame = std::make_shared<qint64>(0);
+    
+    QObject::connect(window, &MainWindow::firstFramePainted, window, [startup, firstFrame]() {
+        *firstFrame = startup->elapsed();
+    });
+    QObject::connect(window, &MainWindow::startupFinished, window, [startup, firstFrame, budgetMs]() {
+        QTextStream out(stdout);
+        out << "first frame: " << *firstFrame << " ms (budget " << budgetMs << " ms)\n";
+        out << "ready:       " << startup->elapsed() << " ms\n";
+        QCoreApplication::exit(*firstFrame <= budgetMs ? 0 : 1);
+    });
+}
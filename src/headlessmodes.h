@@ -0,0 +1,21 @@
+#ifndef HEADLESSMODES_H
+#define HEADLESSMODES_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+class MainWindow;
+
+// Command line modes that drive the editor without a user. Both expect a
+// MainWindow with a transient session, so they never touch the user's.
+
+// Replays the input trace in fileName against window and prints per-event
+// latency percentiles. Returns the process exit code.
+int runReplay(MainWindow *window, const QString &fileName);
+
+// Prints the time from startup to the first frame and until startup work
+// has finished, then leaves the event loop with exit code 1 if the first
+// frame missed budgetMs. startup must outlive the event loop.
+void runStartupBenchmark(MainWindow *window, const QElapsedTimer *startup, qint64 budgetMs);
+
+#endif // HEADLESSMODES_H
@@ -0,0 +1,353 @@
+#include "schematiclayout.h"
+#include "../circuit/circuitscene.h"
+#include "../circuit/elementindex.h"
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+SchematicLayout::SchematicLayout(const QList<NetlistCard> &cards)
+    : cards(cards)
+    , vertexCount(0)
+{
+}
+
+QList<ElementRecord> SchematicLayout::place()
+{
+    if (cards.isEmpty()) {
+        return QList<ElementRecord>();
+    }
+    
+    buildGraph();
+    initialPositions();
+    
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    
+    // Linear cooling from a tenth of the initial extent
+    const double start = std::sqrt(double(vertexCount)) * IDEAL_LENGTH / 10.0;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        double temperature = start * (1.0 - double(i) / ITERATIONS) + 0.01 * IDEAL_LENGTH;
+        iterate(pool, temperature);
+    }
+    
+    return snapToSlots();
+}
+
+void SchematicLayout::buildGraph()
+{
+    const int componentCount = cards.size();
+    QHash<QString, int> nets;
+    QVector<QVector<int>> neighbours(componentCount);
+    
+    for (int i = 0; i < componentCount; ++i) {
+        for (const QString &node : cards.at(i).nodes) {
+            if (SpiceParser::isGround(node)) {
+                continue;
+            }
+            int net = nets.value(node, -1);
+            if (net < 0) {
+                net = componentCount + nets.size();
+                nets.insert(node, net);
+                neighbours.append(QVector<int>());
+            }
+            if (!neighbours[i].contains(net)) {
+                neighbours[i].append(net);
+                neighbours[net].append(i);
+            }
+        }
+    }
+    
+    // Flatten into offsets and targets
+    vertexCount = neighbours.size();
+    adjacencyOffsets.resize(vertexCount + 1);
+    adjacency.clear();
+    for (int v = 0; v < vertexCount; ++v) {
+        adjacencyOffsets[v] = adjacency.size();
+        adjacency += neighbours[v];
+    }
+    adjacencyOffsets[vertexCount] = adjacency.size();
+}
+
+// Vertices are laid out on a square in breadth-first order, so connected
+// parts start close together and the force phase has less to untangle.
+void SchematicLayout::initialPositions()
+{
+    xs.resize(vertexCount);
+    ys.resize(vertexCount);
+    dxs.resize(vertexCount);
+    dys.resize(vertexCount);
+    treeOrder.resize(vertexCount);
+    
+    const int side = qMax(1, int(std::ceil(std::sqrt(double(vertexCount)))));
+    QVector<bool> seen(vertexCount, false);
+    QVector<int> queue;
+    queue.reserve(vertexCount);
+    
+    for (int start = 0; start < vertexCount; ++start) {
+        if (seen[start]) {
+            continue;
+        }
+        seen[start] = true;
+        queue.append(start);
+    
+        for (int head = queue.size() - 1; head < queue.size(); ++head) {
+            int v = queue.at(head);
+            int row = head / side;
+            int column = head % side;
+            if (row % 2) {
+                column = side - 1 - column;
+            }
+            // A slight skew keeps vertices off exact lines
+            xs[v] = (column - side / 2.0 + 0.001 * row) * IDEAL_LENGTH;
+            ys[v] = (row - side / 2.0 + 0.001 * column) * IDEAL_LENGTH;
+            
+            for (int k = adjacencyOffsets[v]; k < adjacencyOffsets[v + 1]; ++k) {
+                int neighbour = adjacency[k];
+                if (!seen[neighbour]) {
+                    seen[neighbour] = true;
+                    queue.append(neighbour);
+                }
+            }
+        }
+    }
+}
+
+void SchematicLayout::iterate(QThreadPool &pool, double temperature)
+{
+    double minX = std::numeric_limits<double>::max();
+    double minY = minX;
+    double maxX = std::numeric_limits<double>::lowest();
+    double maxY = maxX;
+    for (int v = 0; v < vertexCount; ++v) {
+        minX = std::min(minX, xs[v]);
+        maxX = std::max(maxX, xs[v]);
+        minY = std::min(minY, ys[v]);
+        maxY = std::max(maxY, ys[v]);
+        treeOrder[v] = v;
+    }
+    
+    tree.clear();
+    double half = std::max(maxX - minX, maxY - minY) / 2.0 + 1e-9;
+    buildTree(0, vertexCount, (minX + maxX) / 2.0, (minY + maxY) / 2.0, half, 0);
+    
+    // Every task reads all positions and writes only its own displacements
+    const int chunks = pool.maxThreadCount() * 4;
+    const int chunkSize = (vertexCount + chunks - 1) / chunks;
+    for (int first = 0; first < vertexCount; first += chunkSize) {
+        int last = std::min(vertexCount, first + chunkSize);
+        pool.start([this, first, last, temperature]() {
+            computeDisplacements(first, last, temperature);
+        });
+    }
+    pool.waitForDone();
+    
+    for (int v = 0; v < vertexCount; ++v) {
+        xs[v] += dxs[v];
+        ys[v] += dys[v];
+    }
+}
+
+// Splits the bodies in [begin, end) of treeOrder into quadrants in place.
+// Cells with few bodies, or at the depth limit, stay leaves and are
+// evaluated exactly.
+int SchematicLayout::buildTree(int begin, int end, double centerX, double centerY, double half, int depth)
+{
+    const int index = tree.size();
+    tree.append(TreeNode());
+    
+    TreeNode node;
+    node.size = 2.0 * half;
+    node.begin = begin;
+    node.end = end;
+    std::fill(std::begin(node.child), std::end(node.child), -1);
+    
+    double sumX = 0.0;
+    double sumY = 0.0;
+    for (int i = begin; i < end; ++i) {
+        sumX += xs[treeOrder[i]];
+        sumY += ys[treeOrder[i]];
+    }
+    node.mass = end - begin;
+    node.x = sumX / node.mass;
+    node.y = sumY / node.mass;
+    
+    if (end - begin > LEAF_SIZE && depth < MAX_DEPTH) {
+        int *order = treeOrder.data();
+        auto left = [this, centerX](int v) { return xs[v] < centerX; };
+        auto top = [this, centerY](int v) { return ys[v] < centerY; };
+        
+        int middle = int(std::partition(order + begin, order + end, left) - order);
+        int leftMiddle = int(std::partition(order + begin, order + middle, top) - order);
+        int rightMiddle = int(std::partition(order + middle, order + end, top) - order);
+        
+        const int bounds[5] = { begin, leftMiddle, middle, rightMiddle, end };
+        const double quarter = half / 2.0;
+        const double offsetX[4] = { -quarter, -quarter, quarter, quarter };
+        const double offsetY[4] = { -quarter, quarter, -quarter, quarter };
+        
+        for (int c = 0; c < 4; ++c) {
+            if (bounds[c + 1] > bounds[c]) {
+                node.child[c] = buildTree(bounds[c], bounds[c + 1], centerX + offsetX[c],
+                                          centerY + offsetY[c], quarter, depth + 1);
+            }
+        }
+    }
+    
+    tree[index] = node;
+    return index;
+}
+
+void SchematicLayout::computeDisplacements(int first, int last, double temperature)
+{
+    const double k2 = IDEAL_LENGTH * IDEAL_LENGTH;
+    QVarLengthArray<int, 256> stack;
+    
+    for (int v = first; v < last; ++v) {
+        const double x = xs[v];
+        const double y = ys[v];
+        double forceX = 0.0;
+        double forceY = 0.0;
+        
+        // Repulsion, with far cells treated as one body at their center of mass
+        stack.clear();
+        stack.append(0);
+        while (!stack.isEmpty()) {
+            const TreeNode &node = tree.at(stack.last());
+            stack.removeLast();
+            bool leaf = node.child[0] < 0 && node.child[1] < 0 && node.child[2] < 0 && node.child[3] < 0;
+            
+            if (leaf) {
+                for (int i = node.begin; i < node.end; ++i) {
+                    int other = treeOrder[i];
+                    if (other == v) {
+                        continue;
+                    }
+                    double dx = x - xs[other];
+                    double dy = y - ys[other];
+                    double d2 = dx * dx + dy * dy;
+                    if (d2 < 1e-8) {
+                        // Coincident vertices are pushed apart along x
+                        dx = v < other ? -0.01 : 0.01;
+                        dy = 0.0;
+                        d2 = 1e-4;
+                    }
+                    forceX += dx * k2 / d2;
+                    forceY += dy * k2 / d2;
+                }
+                continue;
+            }
+            
+            double dx = x - node.x;
+            double dy = y - node.y;
+            double d2 = dx * dx + dy * dy;
+            if (node.size * node.size < THETA * THETA * d2) {
+                forceX += dx * k2 * node.mass / d2;
+                forceY += dy * k2 * node.mass / d2;
+            } else {
+                for (int child : node.child) {
+                    if (child >= 0) {
+                        stack.append(child);
+                    }
+                }
+            }
+        }
+        
+        // Attraction along edges
+        for (int k = adjacencyOffsets[v]; k < adjacencyOffsets[v + 1]; ++k) {
+            int other = adjacency[k];
+            double dx = xs[other] - x;
+            double dy = ys[other] - y;
+            double distance = std::sqrt(dx * dx + dy * dy);
+            forceX += dx * distance / IDEAL_LENGTH;
+            forceY += dy * distance / IDEAL_LENGTH;
+        }
+        
+        // Gravity keeps unconnected parts from drifting off
+        forceX -= GRAVITY * x;
+        forceY -= GRAVITY * y;
+        
+        double length = std::sqrt(forceX * forceX + forceY * forceY);
+        double step = length > 0.0 ? std::min(length, temperature) / length : 0.0;
+        dxs[v] = forceX * step;
+        dys[v] = forceY * step;
+    }
+}
+
+// Moves every component to the nearest free slot of a coarse grid so no
+// two symbols overlap, then adds a ground symbol one grid step below each
+// grounded terminal. Those grounds can reach past the bottom of the slot,
+// so a grounded component also keeps the slot below it free.
+QList<ElementRecord> SchematicLayout::snapToSlots() const
+{
+    QList<ElementRecord> records;
+    records.reserve(cards.size() * 2);
+    QSet<quint64> occupied;
+    occupied.reserve(cards.size());
+    
+    auto slotKey = [](int column, int row) {
+        return (quint64(quint32(column)) << 32) | quint32(row);
+    };
+    
+    for (int i = 0; i < cards.size(); ++i) {
+        const NetlistCard &card = cards.at(i);
+        const bool grounded = SpiceParser::isGround(card.nodes[0]) || SpiceParser::isGround(card.nodes[1]);
+        auto isFree = [&](int column, int row) {
+            return !occupied.contains(slotKey(column, row))
+                && (!grounded || !occupied.contains(slotKey(column, row + 1)));
+        };
+        
+        const double wantX = xs[i] * PIXELS_PER_UNIT / SLOT_SIZE;
+        const double wantY = ys[i] * PIXELS_PER_UNIT / SLOT_SIZE;
+        int column = qRound(wantX);
+        int row = qRound(wantY);
+        
+        // Search rings around the preferred slot for the closest free one
+        for (int radius = 1; !isFree(column, row); ++radius) {
+            const int centerColumn = qRound(wantX);
+            const int centerRow = qRound(wantY);
+            double best = std::numeric_limits<double>::max();
+            
+            for (int r = centerRow - radius; r <= centerRow + radius; ++r) {
+                int step = (r == centerRow - radius || r == centerRow + radius) ? 1 : 2 * radius;
+                for (int c = centerColumn - radius; c <= centerColumn + radius; c += step) {
+                    double distance = (c - wantX) * (c - wantX) + (r - wantY) * (r - wantY);
+                    if (distance < best && isFree(c, r)) {
+                        best = distance;
+                        column = c;
+                        row = r;
+                    }
+                }
+            }
+        }
+        occupied.insert(slotKey(column, row));
+        if (grounded) {
+            occupied.insert(slotKey(column, row + 1));
+        }
+        
+        ElementRecord record;
+        record.id = 0;
+        record.type = card.type;
+        record.pos = CircuitScene::snapToGrid(QPointF(column * SLOT_SIZE, row * SLOT_SIZE));
+        record.label = SpiceParser::labelFor(card.name);
+        records.append(record);
+        
+        const QList<QPointF> terminals = ElementIndex::terminals(card.type, record.pos);
+        for (int t = 0; t < 2 && t < terminals.size(); ++t) {
+            if (SpiceParser::isGround(card.nodes[t])) {
+                ElementRecord ground;
+                ground.id = 0;
+                ground.type = ElementType::Ground;
+                ground.pos = terminals.at(t) + QPointF(0, CircuitScene::GRID_SIZE);
+                ground.label = CircuitElement::defaultLabel(ElementType::Ground);
+                records.append(ground);
+            }
+        }
+    }
+    
+    return records;
+}
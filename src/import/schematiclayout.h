@@ -0,0 +1,66 @@
+#ifndef SCHEMATICLAYOUT_H
+#define SCHEMATICLAYOUT_H
+
+#include <QList>
+#include <QVector>
+#include "spiceparser.h"
+#include "../circuit/circuitelement.h"
+
+class QThreadPool;
+
+// Places netlist components on the canvas grid.
+//
+// Components and the nets between them form a bipartite graph that is laid
+// out force-directed (Fruchterman-Reingold). Repulsion is approximated with
+// a Barnes-Hut quadtree, so an iteration costs O(n log n), and the forces of
+// an iteration are computed on all cores. Ground is left out of the graph,
+// it would pull everything together; every grounded terminal gets its own
+// ground symbol instead.
+class SchematicLayout
+{
+public:
+    explicit SchematicLayout(const QList<NetlistCard> &cards);
+
+    QList<ElementRecord> place();
+
+private:
+    struct TreeNode {
+        double x, y;      // center of mass
+        double mass;
+        double size;      // edge length of the cell
+        int child[4];     // -1 when empty
+        int begin, end;   // bodies, in treeOrder
+    };
+
+    void buildGraph();
+    void initialPositions();
+    void iterate(QThreadPool &pool, double temperature);
+    int buildTree(int begin, int end, double centerX, double centerY, double half, int depth);
+    void computeDisplacements(int first, int last, double temperature);
+    QList<ElementRecord> snapToSlots() const;
+
+    const QList<NetlistCard> &cards;
+    int vertexCount;
+
+    // Vertices 0..cards.size()-1 are components, the rest are nets
+    QVector<int> adjacencyOffsets;
+    QVector<int> adjacency;
+
+    QVector<double> xs, ys;
+    QVector<double> dxs, dys;
+
+    QVector<TreeNode> tree;
+    QVector<int> treeOrder;
+
+    static constexpr double IDEAL_LENGTH = 1.0;
+    static constexpr double THETA = 0.8;
+    static constexpr double GRAVITY = 2.0;
+    static constexpr int ITERATIONS = 100;
+    static constexpr int LEAF_SIZE = 8;
+    static constexpr int MAX_DEPTH = 24;
+
+    static constexpr double PIXELS_PER_UNIT = 50.0;
+    static constexpr int SLOT_SIZE = 80;  // one component per slot, a multiple of the grid
+};
+
+#endif // SCHEMATICLAYOUT_H
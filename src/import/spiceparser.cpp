@@ -0,0 +1,104 @@
+#include "spiceparser.h"
+#include <QFile>
+#include <QTextStream>
+
+bool SpiceParser::parseFile(const QString &fileName, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    
+    QTextStream in(&file);
+    return parse(in, errorMessage);
+}
+
+bool SpiceParser::parse(QTextStream &in, QString *errorMessage)
+{
+    netlistCards.clear();
+    skipped = 0;
+    
+    // The first line of a netlist is its title
+    in.readLine();
+    
+    QString card;
+    int cardLine = 0;
+    for (int lineNumber = 2; !in.atEnd(); ++lineNumber) {
+        QString line = in.readLine();
+        
+        // Inline comments
+        int comment = line.indexOf(';');
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        line = line.trimmed();
+        
+        if (line.isEmpty() || line.startsWith('*')) {
+            continue;
+        }
+        if (line.startsWith('+')) {
+            card += ' ' + line.mid(1);
+            continue;
+        }
+        
+        if (!card.isEmpty() && !parseCard(card, cardLine, errorMessage)) {
+            return false;
+        }
+        card = line;
+        cardLine = lineNumber;
+        
+        if (line.compare(QLatin1String(".end"), Qt::CaseInsensitive) == 0) {
+            card.clear();
+            break;
+        }
+    }
+    
+    return card.isEmpty() || parseCard(card, cardLine, errorMessage);
+}
+
+bool SpiceParser::parseCard(const QString &card, int lineNumber, QString *errorMessage)
+{
+    NetlistCard parsed;
+    switch (card.at(0).toUpper().toLatin1()) {
+        case 'R': parsed.type = ElementType::Resistor; break;
+        case 'C': parsed.type = ElementType::Capacitor; break;
+        case 'L': parsed.type = ElementType::Inductor; break;
+        case 'V': parsed.type = ElementType::VoltageSource; break;
+        case 'I': parsed.type = ElementType::CurrentSource; break;
+        case '.':
+            return true;
+        default:
+            ++skipped;
+            return true;
+    }
+    
+    const QStringList fields = card.simplified().split(QLatin1Char(' '));
+    if (fields.size() < 3) {
+        *errorMessage = QString("Line %1: '%2' needs two nodes").arg(lineNumber).arg(fields.first());
+        return false;
+    }
+    
+    parsed.name = fields.at(0);
+    parsed.nodes[0] = fields.at(1).toLower();
+    parsed.nodes[1] = fields.at(2).toLower();
+    parsed.value = fields.mid(3).join(' ');
+    netlistCards.append(parsed);
+    return true;
+}
+
+bool SpiceParser::isGround(const QString &node)
+{
+    return node == QLatin1String("0") || node == QLatin1String("gnd") || node == QLatin1String("gnd!");
+}
+
+// "R12" becomes "R_{12}", the way the editor labels elements
+QString SpiceParser::labelFor(const QString &name)
+{
+    QString label = name.left(1).toUpper();
+    if (name.size() > 1) {
+        label += "_{" + name.mid(1) + '}';
+    }
+    label.remove('$');
+    return label;
+}
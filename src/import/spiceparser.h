@@ -0,0 +1,39 @@
+#ifndef SPICEPARSER_H
+#define SPICEPARSER_H
+
+#include <QList>
+#include <QString>
+#include "../circuit/circuitelement.h"
+
+class QTextStream;
+
+struct NetlistCard {
+    ElementType type = ElementType::Resistor;
+    QString name;
+    QString nodes[2];
+    QString value;
+};
+
+// Reads the two-terminal R, C, L, V and I cards of a SPICE netlist. The
+// title line, comments, dot commands and any other device are skipped;
+// node names are compared case-insensitively, "0" and "gnd" are ground.
+class SpiceParser
+{
+public:
+    bool parseFile(const QString &fileName, QString *errorMessage);
+    bool parse(QTextStream &in, QString *errorMessage);
+
+    const QList<NetlistCard> &cards() const { return netlistCards; }
+    int skippedCards() const { return skipped; }
+
+    static bool isGround(const QString &node);
+    static QString labelFor(const QString &name);
+
+private:
+    bool parseCard(const QString &card, int lineNumber, QString *errorMessage);
+
+    QList<NetlistCard> netlistCards;
+    int skipped = 0;
+};
+
+#endif // SPICEPARSER_H
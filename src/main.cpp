@@ -1,14 +1,70 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cstring>
 #include "mainwindow.h"
+#include "headlessmodes.h"
+
+// Time from entering main() to the first painted frame, see README
+static constexpr qint64 STARTUP_BUDGET_MS = 250;
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startup;
+    startup.start();
+    
+    // Replays and benchmarks run headless unless a platform was chosen explicitly
+    for (int i = 1; i < argc; ++i) {
+        if ((std::strcmp(argv[i], "--replay") == 0 || std::strcmp(argv[i], "--startup-benchmark") == 0)
+            && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+    
     QApplication app(argc, argv);
     app.setApplicationName("CircuiTikZ Editor");
     app.setApplicationVersion("1.0.0");
     app.setOrganizationName("CircuiTikZ Editor Team");
     
-    MainWindow window;
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption recordOption("record", "Record canvas input to <trace>.", "trace");
+    QCommandLineOption replayOption("replay",
+        "Replay <trace> and print per-event latency percentiles.", "trace");
+    QCommandLineOption benchmarkOption("startup-benchmark",
+        "Print startup times and fail if the first frame misses the budget.");
+    QCommandLineOption budgetOption("startup-budget",
+        "Startup budget in milliseconds for --startup-benchmark.", "ms",
+        QString::number(STARTUP_BUDGET_MS));
+    parser.addOption(recordOption);
+    parser.addOption(replayOption);
+    parser.addOption(benchmarkOption);
+    parser.addOption(budgetOption);
+    parser.process(app);
+    
+    // Replays and the startup benchmark never read or write the user's session
+    const bool headless = parser.isSet(replayOption) || parser.isSet(benchmarkOption);
+    MainWindow window(headless ? MainWindow::Session::Transient : MainWindow::Session::Persistent);
+    
+    if (parser.isSet(replayOption)) {
+        return runReplay(&window, parser.value(replayOption));
+    }
+    if (parser.isSet(benchmarkOption)) {
+        runStartupBenchmark(&window, &startup, parser.value(budgetOption).toLongLong());
+    }
+    
+    if (parser.isSet(recordOption)) {
+        // Record from the document as loaded, not from its placeholder
+        QObject::connect(&window, &MainWindow::startupFinished, [&]() {
+            QString error;
+            if (!window.startRecording(parser.value(recordOption), &error)) {
+                QTextStream(stderr) << "Could not record input: " << error << Qt::endl;
+            }
+        });
+    }
+    
     window.show();
     
     return app.exec();
@@ -1,11 +1,18 @@
 #include "mainwindow.h"
 #include "circuit/circuitcanvas.h"
 #include "circuit/tikzgenerator.h"
+#include "editor/tikzcodeeditor.h"
+#include "editor/tikzsync.h"
+#include "export/imageexporter.h"
+#include "documenttab.h"
+#include "trace/inputrecorder.h"
+#include "import/spiceparser.h"
+#include "import/schematiclayout.h"
+#include "diff/circuitdiff.h"
 #include <QApplication>
 #include <QMenuBar>
 #include <QToolBar>
 #include <QStatusBar>
-#include <QTextEdit>
 #include <QSplitter>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -15,26 +22,38 @@
 #include <QMessageBox>
 #include <QTextStream>
 #include <QAction>
+#include <QInputDialog>
+#include <QThreadPool>
+#include <QPointer>
+#include <QSettings>
+#include <QCloseEvent>
+#include <QSignalBlocker>
+#include <QTimer>
+#include <utility>
 
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(Session session, QWidget *parent)
     : QMainWindow(parent)
     , centralWidget(nullptr)
-    , splitter(nullptr)
-    , canvas(nullptr)
-    , tikzCodeEditor(nullptr)
+    , documents(nullptr)
+    , activeDocument(nullptr)
     , elementToolbar(nullptr)
+    , queryToolbar(nullptr)
+    , queryEdit(nullptr)
     , tikzGenerator(nullptr)
+    , recorder(nullptr)
+    , toolsMenu(nullptr)
+    , recordAction(nullptr)
+    , firstFrameDone(false)
+    , highDensity(false)
+    , session(session)
 {
+    // One generator serves every tab
+    tikzGenerator = new TikzGenerator(this);
+    
     setupUI();
     setupMenus();
     setupToolbars();
-    
-    // Initialize TikZ generator
-    tikzGenerator = new TikzGenerator(this);
-    
-    // Connect canvas to TikZ code update
-    connect(canvas, &CircuitCanvas::circuitChanged, 
-            this, &MainWindow::updateTikZCode);
+    restoreSession();
     
     setWindowTitle("CircuiTikZ Editor v1.0");
     resize(1200, 800);
@@ -49,26 +68,17 @@ void MainWindow::setupUI()
     centralWidget = new QWidget;
     setCentralWidget(centralWidget);
     
-    // Create main splitter
-    splitter = new QSplitter(Qt::Horizontal, this);
-    
-    // Create circuit canvas
-    canvas = new CircuitCanvas(this);
-    canvas->setMinimumSize(600, 400);
-    
-    // Create TikZ code editor
-    tikzCodeEditor = new QTextEdit(this);
-    tikzCodeEditor->setMinimumSize(300, 400);
-    tikzCodeEditor->setPlainText("% TikZ code will appear here\n\\begin{circuitikz}\n\n\\end{circuitikz}");
-    
-    // Add widgets to splitter
-    splitter->addWidget(canvas);
-    splitter->addWidget(tikzCodeEditor);
-    splitter->setSizes({800, 400});
+    // One tab per open circuit
+    documents = new QTabWidget(this);
+    documents->setTabsClosable(true);
+    documents->setMovable(true);
+    documents->setDocumentMode(true);
+    connect(documents, &QTabWidget::currentChanged, this, &MainWindow::currentDocumentChanged);
+    connect(documents, &QTabWidget::tabCloseRequested, this, &MainWindow::closeDocument);
     
     // Create main layout
     QVBoxLayout *mainLayout = new QVBoxLayout;
-    mainLayout->addWidget(splitter);
+    mainLayout->addWidget(documents);
     centralWidget->setLayout(mainLayout);
 }
 
@@ -92,6 +102,10 @@ void MainWindow::setupMenus()
     connect(saveAction, &QAction::triggered, this, &MainWindow::saveCircuit);
     fileMenu->addAction(saveAction);
     
+    QAction *importAction = new QAction("Import SPICE Netlist...", this);
+    connect(importAction, &QAction::triggered, this, &MainWindow::importNetlist);
+    fileMenu->addAction(importAction);
+    
     fileMenu->addSeparator();
     
     QAction *exportAction = new QAction("Export as TikZ", this);
@@ -99,12 +113,59 @@ void MainWindow::setupMenus()
     connect(exportAction, &QAction::triggered, this, &MainWindow::exportTikZ);
     fileMenu->addAction(exportAction);
     
+    QAction *exportPngAction = new QAction("Export as PNG...", this);
+    connect(exportPngAction, &QAction::triggered, this, &MainWindow::exportPng);
+    fileMenu->addAction(exportPngAction);
+    
+    QAction *exportSvgAction = new QAction("Export as SVG...", this);
+    connect(exportSvgAction, &QAction::triggered, this, &MainWindow::exportSvg);
+    fileMenu->addAction(exportSvgAction);
+    
     fileMenu->addSeparator();
     
     QAction *exitAction = new QAction("E&xit", this);
     exitAction->setShortcut(QKeySequence::Quit);
     connect(exitAction, &QAction::triggered, this, &QWidget::close);
     fileMenu->addAction(exitAction);
+    
+    // Tools Menu, filled when first opened
+    toolsMenu = menuBar()->addMenu("&Tools");
+    connect(toolsMenu, &QMenu::aboutToShow, this, &MainWindow::populateToolsMenu);
+}
+
+void MainWindow::populateToolsMenu()
+{
+    if (recordAction) {
+        return;
+    }
+    
+    recordAction = new QAction("Record Input Trace...", this);
+    recordAction->setCheckable(true);
+    recordAction->setChecked(recorder != nullptr);
+    connect(recordAction, &QAction::toggled, this, &MainWindow::toggleRecording);
+    toolsMenu->addAction(recordAction);
+    
+    toolsMenu->addSeparator();
+    
+    QAction *compareAction = new QAction("Compare With Revision...", this);
+    connect(compareAction, &QAction::triggered, this, &MainWindow::compareRevision);
+    toolsMenu->addAction(compareAction);
+    
+    QAction *mergeAction = new QAction("Merge Revisions...", this);
+    connect(mergeAction, &QAction::triggered, this, &MainWindow::mergeRevisions);
+    toolsMenu->addAction(mergeAction);
+    
+    QAction *clearCompareAction = new QAction("Clear Comparison", this);
+    connect(clearCompareAction, &QAction::triggered, this, &MainWindow::clearComparison);
+    toolsMenu->addAction(clearCompareAction);
+    
+    toolsMenu->addSeparator();
+    
+    QAction *highDensityAction = new QAction("High-Density Mode", this);
+    highDensityAction->setCheckable(true);
+    highDensityAction->setChecked(highDensity);
+    connect(highDensityAction, &QAction::toggled, this, &MainWindow::setHighDensity);
+    toolsMenu->addAction(highDensityAction);
 }
 
 void MainWindow::setupToolbars()
@@ -135,13 +196,38 @@ void MainWindow::setupToolbars()
     connect(groundBtn, &QPushButton::clicked, this, &MainWindow::addGround);
     elementToolbar->addWidget(groundBtn);
     
+    // Query bar: find elements through the canvas indexes
+    queryToolbar = addToolBar("Query");
+    
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText("type=Resistor label=R_1* in=0,0,10,-5 node=2,0");
+    queryEdit->setClearButtonEnabled(true);
+    queryEdit->setMinimumWidth(300);
+    connect(queryEdit, &QLineEdit::returnPressed, this, &MainWindow::selectQueryResults);
+    queryToolbar->addWidget(queryEdit);
+    
+    QPushButton *selectBtn = new QPushButton("Select", this);
+    connect(selectBtn, &QPushButton::clicked, this, &MainWindow::selectQueryResults);
+    queryToolbar->addWidget(selectBtn);
+    
+    QPushButton *zoomBtn = new QPushButton("Zoom", this);
+    connect(zoomBtn, &QPushButton::clicked, this, &MainWindow::zoomQueryResults);
+    queryToolbar->addWidget(zoomBtn);
+    
+    QAction *findAction = new QAction("Find Elements", this);
+    findAction->setShortcut(QKeySequence::Find);
+    connect(findAction, &QAction::triggered, this, [this]() {
+        queryEdit->setFocus();
+        queryEdit->selectAll();
+    });
+    addAction(findAction);
+    
     statusBar()->showMessage("Ready");
 }
 
 void MainWindow::newCircuit()
 {
-    canvas->clearCircuit();
-    updateTikZCode();
+    documents->setCurrentWidget(addDocument(QString()));
     statusBar()->showMessage("New circuit created", 2000);
 }
 
@@ -151,27 +237,33 @@ void MainWindow::openCircuit()
         "Open Circuit", "", "TikZ Files (*.tex);;All Files (*)");
     
     if (!fileName.isEmpty()) {
-        QFile file(fileName);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            tikzCodeEditor->setPlainText(in.readAll());
+        for (int i = 0; i < documents->count(); ++i) {
+            DocumentTab *document = qobject_cast<DocumentTab*>(documents->widget(i));
+            if (document->filePath() == fileName) {
+                documents->setCurrentIndex(i);
+                return;
+            }
+        }
+        
+        // The file is read when the tab is activated
+        documents->setCurrentWidget(addDocument(fileName));
+        if (currentDocument()->isLoaded()) {
             statusBar()->showMessage("Circuit loaded", 2000);
-        } else {
-            QMessageBox::warning(this, "Error", "Could not open file");
         }
     }
 }
 
 void MainWindow::saveCircuit()
 {
+    DocumentTab *document = currentDocument();
     QString fileName = QFileDialog::getSaveFileName(this,
-        "Save Circuit", "", "TikZ Files (*.tex);;All Files (*)");
+        "Save Circuit", document->filePath(), "TikZ Files (*.tex);;All Files (*)");
     
     if (!fileName.isEmpty()) {
-        QFile file(fileName);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            QTextStream out(&file);
-            out << tikzCodeEditor->toPlainText();
+        QString error;
+        if (document->save(fileName, &error)) {
+            documents->setTabText(documents->indexOf(document), document->title());
+            documents->setTabToolTip(documents->indexOf(document), fileName);
             statusBar()->showMessage("Circuit saved", 2000);
         } else {
             QMessageBox::warning(this, "Error", "Could not save file");
@@ -179,6 +271,234 @@ void MainWindow::saveCircuit()
     }
 }
 
+DocumentTab *MainWindow::addDocument(const QString &filePath)
+{
+    DocumentTab *document = new DocumentTab(tikzGenerator, filePath, documents);
+    int index = documents->addTab(document, document->title());
+    documents->setTabToolTip(index, filePath);
+    return document;
+}
+
+DocumentTab *MainWindow::currentDocument() const
+{
+    return activeDocument;
+}
+
+// Only the tab being shown holds scene items; the one left behind drops
+// them and keeps its circuit in the scene's element store.
+void MainWindow::currentDocumentChanged(int index)
+{
+    DocumentTab *document = qobject_cast<DocumentTab*>(documents->widget(index));
+    if (document == activeDocument) {
+        return;
+    }
+    
+    // A trace covers a single canvas
+    if (recorder) {
+        stopRecording();
+    }
+    
+    if (activeDocument) {
+        activeDocument->deactivate();
+    }
+    activeDocument = document;
+    
+    if (!document) {
+        return;
+    }
+    
+    // The mode is set before the items are restored, so a high-density
+    // document never builds them. Until the first frame is up the document
+    // only gets its widgets.
+    document->prepare();
+    document->canvas()->setHighDensity(highDensity);
+    if (firstFrameDone) {
+        loadDocument(document);
+    }
+}
+
+// Inactive documents hold no items, they pick the mode up when shown
+void MainWindow::setHighDensity(bool enabled)
+{
+    highDensity = enabled;
+    if (recorder) {
+        recorder->recordHighDensity(enabled);
+    }
+    if (activeDocument) {
+        activeDocument->canvas()->setHighDensity(enabled);
+    }
+    statusBar()->showMessage(enabled ? "High-density mode on" : "High-density mode off", 2000);
+}
+
+void MainWindow::loadDocument(DocumentTab *document)
+{
+    QString error;
+    if (!document->activate(&error)) {
+        // The tab stays open with an empty circuit
+        int index = documents->indexOf(document);
+        QMessageBox::warning(this, "Error", "Could not open file: " + error);
+        documents->setTabText(index, document->title());
+        documents->setTabToolTip(index, document->filePath());
+    }
+}
+
+void MainWindow::closeDocument(int index)
+{
+    QWidget *document = documents->widget(index);
+    
+    // Always keep one document open
+    if (documents->count() == 1) {
+        addDocument(QString());
+    }
+    
+    if (document == activeDocument) {
+        activeDocument = nullptr;
+    }
+    documents->removeTab(documents->indexOf(document));
+    currentDocumentChanged(documents->currentIndex());
+    document->deleteLater();
+}
+
+// Restored tabs are created unloaded; only the one that becomes current
+// reads its file.
+void MainWindow::restoreSession()
+{
+    QStringList files;
+    int current = 0;
+    if (session == Session::Persistent) {
+        QSettings settings;
+        files = settings.value("session/files").toStringList();
+        current = settings.value("session/current", 0).toInt();
+    }
+    
+    {
+        // Adding the first tab would otherwise load it straight away
+        QSignalBlocker blocker(documents);
+        for (const QString &fileName : files) {
+            if (QFile::exists(fileName)) {
+                addDocument(fileName);
+            }
+        }
+        
+        if (documents->count() == 0) {
+            addDocument(QString());
+        }
+        documents->setCurrentIndex(qBound(0, current, documents->count() - 1));
+    }
+    currentDocumentChanged(documents->currentIndex());
+}
+
+void MainWindow::saveSession()
+{
+    if (session == Session::Transient) {
+        return;
+    }
+    
+    QStringList files;
+    int current = 0;
+    for (int i = 0; i < documents->count(); ++i) {
+        DocumentTab *document = qobject_cast<DocumentTab*>(documents->widget(i));
+        if (document->filePath().isEmpty()) {
+            continue;
+        }
+        if (i == documents->currentIndex()) {
+            current = files.size();
+        }
+        files.append(document->filePath());
+    }
+    
+    QSettings settings;
+    settings.setValue("session/files", files);
+    settings.setValue("session/current", current);
+}
+
+bool MainWindow::startRecording(const QString &fileName, QString *errorMessage)
+{
+    stopRecording();
+    
+    DocumentTab *document = currentDocument();
+    recorder = new InputRecorder(this);
+    if (!recorder->start(fileName, this, document, errorMessage)) {
+        delete recorder;
+        recorder = nullptr;
+        return false;
+    }
+    
+    if (recordAction) {
+        QSignalBlocker blocker(recordAction);
+        recordAction->setChecked(true);
+    }
+    statusBar()->showMessage("Recording input to " + fileName);
+    return true;
+}
+
+void MainWindow::stopRecording()
+{
+    if (!recorder) {
+        return;
+    }
+    
+    delete recorder;
+    recorder = nullptr;
+    
+    if (recordAction) {
+        QSignalBlocker blocker(recordAction);
+        recordAction->setChecked(false);
+    }
+    statusBar()->showMessage("Input recording stopped", 2000);
+}
+
+void MainWindow::toggleRecording(bool checked)
+{
+    if (!checked) {
+        stopRecording();
+        return;
+    }
+    
+    QString fileName = QFileDialog::getSaveFileName(this,
+        "Record Input Trace", "", "Input Traces (*.trace);;All Files (*)");
+    
+    QString error;
+    if (fileName.isEmpty() || !startRecording(fileName, &error)) {
+        QSignalBlocker blocker(recordAction);
+        recordAction->setChecked(false);
+        if (!error.isEmpty()) {
+            QMessageBox::warning(this, "Error", "Could not record input: " + error);
+        }
+    }
+}
+
+bool MainWindow::event(QEvent *event)
+{
+    bool result = QMainWindow::event(event);
+    
+    if (event->type() == QEvent::Paint && !firstFrameDone) {
+        // Children are painted in the same pass; the timer fires once the
+        // whole frame has been flushed
+        firstFrameDone = true;
+        QTimer::singleShot(0, this, &MainWindow::finishStartup);
+    }
+    return result;
+}
+
+void MainWindow::finishStartup()
+{
+    emit firstFramePainted();
+    
+    if (activeDocument) {
+        loadDocument(activeDocument);
+    }
+    
+    emit startupFinished();
+}
+
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    stopRecording();
+    saveSession();
+    QMainWindow::closeEvent(event);
+}
+
 void MainWindow::exportTikZ()
 {
     QString fileName = QFileDialog::getSaveFileName(this,
@@ -191,53 +511,337 @@ void MainWindow::exportTikZ()
             out << "\\documentclass{article}\n";
             out << "\\usepackage{circuitikz}\n";
             out << "\\begin{document}\n";
-            out << tikzCodeEditor->toPlainText();
+            out << currentDocument()->editor()->toPlainText();
             out << "\n\\end{document}\n";
             statusBar()->showMessage("TikZ exported", 2000);
         }
     }
 }
 
+void MainWindow::exportPng()
+{
+    bool ok = false;
+    int dpi = QInputDialog::getInt(this, "Export PNG", "Resolution (DPI):", 300, 10, 9600, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    
+    QString fileName = QFileDialog::getSaveFileName(this,
+        "Export PNG", "", "PNG Images (*.png)");
+    
+    if (!fileName.isEmpty()) {
+        ImageExporter exporter(currentDocument()->canvas()->snapshot());
+        QString error;
+        QSize size = exporter.imageSize(dpi, &error);
+        if (!error.isEmpty()) {
+            QMessageBox::warning(this, "Error", "Could not export PNG: " + error);
+            return;
+        }
+        runInBackground([exporter, fileName, dpi](QString *error) {
+                            return exporter.exportPng(fileName, dpi, error);
+                        },
+                        QString("PNG exported (%1x%2)").arg(size.width()).arg(size.height()),
+                        "Could not export PNG: ");
+        statusBar()->showMessage("Exporting PNG...");
+    }
+}
+
+void MainWindow::exportSvg()
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+        "Export SVG", "", "SVG Images (*.svg)");
+    
+    if (!fileName.isEmpty()) {
+        ImageExporter exporter(currentDocument()->canvas()->snapshot());
+        runInBackground([exporter, fileName](QString *error) {
+                            return exporter.exportSvg(fileName, 96, error);
+                        },
+                        "SVG exported", "Could not export SVG: ");
+        statusBar()->showMessage("Exporting SVG...");
+    }
+}
+
+void MainWindow::importNetlist()
+{
+    QString fileName = QFileDialog::getOpenFileName(this,
+        "Import SPICE Netlist", "", "SPICE Netlists (*.cir *.net *.sp *.spice);;All Files (*)");
+    
+    if (!fileName.isEmpty()) {
+        importNetlistFile(fileName);
+    }
+}
+
+// Parsing and layout run on a pool thread; the placed elements go into a
+// new tab once they are ready.
+void MainWindow::importNetlistFile(const QString &fileName)
+{
+    // The recording moves on to the new tab, where the replay's import
+    // opens its own
+    InputRecorder *following = std::exchange(recorder, nullptr);
+    if (following) {
+        following->recordImport(fileName);
+    }
+    newCircuit();
+    recorder = following;
+    if (recorder) {
+        recorder->setDocument(currentDocument());
+    }
+    
+    QPointer<MainWindow> window(this);
+    QPointer<DocumentTab> document(currentDocument());
+    
+    QThreadPool::globalInstance()->start([=]() {
+        SpiceParser parser;
+        QString error;
+        QList<ElementRecord> records;
+        bool ok = parser.parseFile(fileName, &error);
+        if (ok) {
+            records = SchematicLayout(parser.cards()).place();
+        }
+        const int skipped = parser.skippedCards();
+        
+        QMetaObject::invokeMethod(qApp, [=]() {
+            if (!window || !document) {
+                return;
+            }
+            if (!ok) {
+                QMessageBox::warning(window, "Error", "Could not import netlist: " + error);
+                return;
+            }
+            
+            window->documents->setCurrentWidget(document);
+            document->canvas()->importElements(records);
+            QString message = QString("Imported %1 element(s)").arg(records.size());
+            if (skipped > 0) {
+                message += QString(", skipped %1 unsupported card(s)").arg(skipped);
+            }
+            window->statusBar()->showMessage(message, 4000);
+        }, Qt::QueuedConnection);
+    });
+    statusBar()->showMessage("Importing netlist...");
+}
+
+// Shows what changed since the chosen revision: the file is the "before",
+// the current document the "after".
+void MainWindow::compareRevision()
+{
+    QString fileName = QFileDialog::getOpenFileName(this,
+        "Compare With Revision", "", "TikZ Files (*.tex);;All Files (*)");
+    
+    if (fileName.isEmpty()) {
+        return;
+    }
+    
+    QPointer<MainWindow> window(this);
+    QPointer<DocumentTab> document(currentDocument());
+    const CircuitSnapshot current = document->canvas()->snapshot();
+    
+    QThreadPool::globalInstance()->start([=]() {
+        QList<ElementRecord> revision;
+        QString error;
+        bool ok = CircuitDiff::readRevision(fileName, &revision, &error);
+        CircuitDiff diff;
+        if (ok) {
+            diff = CircuitDiff::compare(revision, CircuitDiff::records(current));
+        }
+        
+        QMetaObject::invokeMethod(qApp, [=]() {
+            if (!window || !document) {
+                return;
+            }
+            if (!ok) {
+                QMessageBox::warning(window, "Error", "Could not read revision: " + error);
+                return;
+            }
+            
+            document->canvas()->showDiff(diff);
+            window->statusBar()->showMessage(QString("%1 added, %2 removed, %3 moved, %4 relabeled")
+                                              .arg(diff.added.size())
+                                              .arg(diff.removed.size())
+                                              .arg(diff.moved.size())
+                                              .arg(diff.relabeled.size()), 4000);
+        }, Qt::QueuedConnection);
+    });
+    statusBar()->showMessage("Comparing...");
+}
+
+void MainWindow::mergeRevisions()
+{
+    QString baseName = QFileDialog::getOpenFileName(this,
+        "Merge: Common Base Revision", "", "TikZ Files (*.tex);;All Files (*)");
+    if (baseName.isEmpty()) {
+        return;
+    }
+    QString theirName = QFileDialog::getOpenFileName(this,
+        "Merge: Revision To Merge In", "", "TikZ Files (*.tex);;All Files (*)");
+    if (!theirName.isEmpty()) {
+        mergeRevisionFiles(baseName, theirName);
+    }
+}
+
+// Merges the changes between a base revision and "their" revision into the
+// current document, which acts as "ours".
+void MainWindow::mergeRevisionFiles(const QString &baseName, const QString &theirName)
+{
+    if (recorder) {
+        recorder->recordMerge(baseName, theirName);
+    }
+    
+    QPointer<MainWindow> window(this);
+    QPointer<DocumentTab> document(currentDocument());
+    const CircuitSnapshot current = document->canvas()->snapshot();
+    
+    QThreadPool::globalInstance()->start([=]() {
+        QList<ElementRecord> base;
+        QList<ElementRecord> theirs;
+        QString error;
+        bool ok = CircuitDiff::readRevision(baseName, &base, &error)
+            && CircuitDiff::readRevision(theirName, &theirs, &error);
+        
+        const QList<ElementRecord> ours = CircuitDiff::records(current);
+        CircuitMerge merge;
+        CircuitDiff incoming;
+        if (ok) {
+            merge = CircuitMerge::merge(base, ours, theirs);
+            incoming = CircuitDiff::compare(ours, merge.result);
+        }
+        
+        QMetaObject::invokeMethod(qApp, [=]() {
+            if (!window || !document) {
+                return;
+            }
+            if (!ok) {
+                QMessageBox::warning(window, "Error", "Could not read revision: " + error);
+                return;
+            }
+            
+            // The document was edited meanwhile; merging now would lose that
+            if (document->canvas()->snapshot().version() != current.version()) {
+                window->statusBar()->showMessage("Circuit changed during merge, merge discarded", 4000);
+                return;
+            }
+            
+            // Applied by id, so unchanged elements keep their code lines
+            window->documents->setCurrentWidget(document);
+            CircuitCanvas *canvas = document->canvas();
+            canvas->applyRecords(merge.result);
+            canvas->showDiff(incoming);
+            
+            if (merge.conflicts.isEmpty()) {
+                window->statusBar()->showMessage("Revisions merged", 4000);
+            } else {
+                QMessageBox::information(window, "Merge",
+                    QString("%1 element(s) were changed on both sides; our version was kept.")
+                        .arg(merge.conflicts.size()));
+            }
+        }, Qt::QueuedConnection);
+    });
+    statusBar()->showMessage("Merging...");
+}
+
+void MainWindow::clearComparison()
+{
+    currentDocument()->canvas()->clearDiff();
+}
+
+// Runs job on a pool thread. Jobs only read circuit snapshots, so editing
+// continues while they run; the outcome is reported back on the GUI thread.
+void MainWindow::runInBackground(const std::function<bool(QString*)> &job,
+                                 const QString &doneMessage, const QString &failMessage)
+{
+    QPointer<MainWindow> window(this);
+    
+    QThreadPool::globalInstance()->start([=]() {
+        QString error;
+        bool ok = job(&error);
+        
+        QMetaObject::invokeMethod(qApp, [=]() {
+            if (!window) {
+                return;
+            }
+            if (ok) {
+                window->statusBar()->showMessage(doneMessage, 4000);
+            } else {
+                QMessageBox::warning(window, "Error", failMessage + error);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
 void MainWindow::addResistor()
 {
-    canvas->setActiveElementType(ElementType::Resistor);
-    statusBar()->showMessage("Click to place resistor");
+    activateTool(ElementType::Resistor, "Click to place resistor");
 }
 
 void MainWindow::addCapacitor()
 {
-    canvas->setActiveElementType(ElementType::Capacitor);
-    statusBar()->showMessage("Click to place capacitor");
+    activateTool(ElementType::Capacitor, "Click to place capacitor");
 }
 
 void MainWindow::addInductor()
 {
-    canvas->setActiveElementType(ElementType::Inductor);
-    statusBar()->showMessage("Click to place inductor");
+    activateTool(ElementType::Inductor, "Click to place inductor");
 }
 
 void MainWindow::addVoltageSource()
 {
-    canvas->setActiveElementType(ElementType::VoltageSource);
-    statusBar()->showMessage("Click to place voltage source");
+    activateTool(ElementType::VoltageSource, "Click to place voltage source");
 }
 
 void MainWindow::addCurrentSource()
 {
-    canvas->setActiveElementType(ElementType::CurrentSource);
-    statusBar()->showMessage("Click to place current source");
+    activateTool(ElementType::CurrentSource, "Click to place current source");
 }
 
 void MainWindow::addGround()
 {
-    canvas->setActiveElementType(ElementType::Ground);
-    statusBar()->showMessage("Click to place ground");
+    activateTool(ElementType::Ground, "Click to place ground");
+}
+
+void MainWindow::activateTool(ElementType type, const QString &message)
+{
+    currentDocument()->canvas()->setActiveElementType(type);
+    if (recorder) {
+        recorder->recordTool(type);
+    }
+    statusBar()->showMessage(message);
+}
+
+void MainWindow::selectQueryResults()
+{
+    runQuery(queryEdit->text(), false);
+}
+
+void MainWindow::zoomQueryResults()
+{
+    runQuery(queryEdit->text(), true);
+}
+
+void MainWindow::runQuery(const QString &query, bool zoom)
+{
+    if (recorder) {
+        recorder->recordQuery(query, zoom);
+    }
+    
+    CircuitCanvas *canvas = currentDocument()->canvas();
+    QString error;
+    QList<quint64> found = canvas->findElements(query, &error);
+    
+    if (!error.isEmpty()) {
+        statusBar()->showMessage("Query error: " + error, 4000);
+        return;
+    }
+    
+    canvas->selectElements(found);
+    if (zoom) {
+        canvas->zoomToElements(found);
+    }
+    statusBar()->showMessage(QString("%1 element(s) found").arg(found.size()), 4000);
 }
 
 void MainWindow::updateTikZCode()
 {
-    if (tikzGenerator && canvas) {
-        QString tikzCode = tikzGenerator->generateFromCanvas(canvas);
-        tikzCodeEditor->setPlainText(tikzCode);
+    if (currentDocument()) {
+        currentDocument()->sync()->regenerate();
     }
 }
@@ -5,30 +5,66 @@
 #include <QMenuBar>
 #include <QToolBar>
 #include <QStatusBar>
-#include <QTextEdit>
 #include <QSplitter>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
 #include <QLabel>
+#include <QLineEdit>
+#include <QTabWidget>
+#include <functional>
 #include "circuit/circuitelement.h"
 
-class CircuitCanvas;
 class TikzGenerator;
+class DocumentTab;
+class InputRecorder;
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    // A transient session starts with one empty document and never touches
+    // the saved session, so benchmark and replay runs are reproducible and
+    // leave the user's open files alone.
+    enum class Session { Persistent, Transient };
+
+    explicit MainWindow(Session session = Session::Persistent, QWidget *parent = nullptr);
     ~MainWindow();
 
-private slots:
+    DocumentTab *currentDocument() const;
+    bool startRecording(const QString &fileName, QString *errorMessage);
+    void stopRecording();
+    
+    // Menu actions past their dialogs, as recorded in input traces
+    void importNetlistFile(const QString &fileName);
+    void mergeRevisionFiles(const QString &baseName, const QString &theirName);
+    void runQuery(const QString &query, bool zoom);
+
+signals:
+    // Startup milestones: the first frame has been flushed to the screen,
+    // and the work deferred past it is done.
+    void firstFramePainted();
+    void startupFinished();
+
+public slots:
     void newCircuit();
+    void setHighDensity(bool enabled);
+
+protected:
+    bool event(QEvent *event) override;
+    void closeEvent(QCloseEvent *event) override;
+
+private slots:
     void openCircuit();
     void saveCircuit();
     void exportTikZ();
+    void exportPng();
+    void exportSvg();
+    void importNetlist();
+    void compareRevision();
+    void mergeRevisions();
+    void clearComparison();
     void addResistor();
     void addCapacitor();
     void addInductor();
@@ -36,18 +72,39 @@ private slots:
     void addCurrentSource();
     void addGround();
     void updateTikZCode();
+    void selectQueryResults();
+    void zoomQueryResults();
+    void currentDocumentChanged(int index);
+    void closeDocument(int index);
+    void toggleRecording(bool checked);
+    void finishStartup();
 
 private:
     void setupUI();
     void setupMenus();
     void setupToolbars();
+    void activateTool(ElementType type, const QString &message);
+    void populateToolsMenu();
+    void loadDocument(DocumentTab *document);
+    DocumentTab *addDocument(const QString &filePath);
+    void restoreSession();
+    void saveSession();
+    void runInBackground(const std::function<bool(QString*)> &job,
+                         const QString &doneMessage, const QString &failMessage);
     
     QWidget *centralWidget;
-    QSplitter *splitter;
-    CircuitCanvas *canvas;
-    QTextEdit *tikzCodeEditor;
+    QTabWidget *documents;
+    DocumentTab *activeDocument;
     QToolBar *elementToolbar;
+    QToolBar *queryToolbar;
+    QLineEdit *queryEdit;
     TikzGenerator *tikzGenerator;
+    InputRecorder *recorder;
+    QMenu *toolsMenu;
+    QAction *recordAction;
+    bool firstFrameDone;
+    bool highDensity;
+    Session session;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,193 @@
+#include "inputrecorder.h"
+#include "../documenttab.h"
+#include "../circuit/circuitcanvas.h"
+#include "../editor/tikzcodeeditor.h"
+#include "../editor/tikzsync.h"
+#include <QMainWindow>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextDocument>
+
+InputRecorder::InputRecorder(QObject *parent)
+    : QObject(parent)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    stop();
+}
+
+bool InputRecorder::start(const QString &fileName, QMainWindow *window, DocumentTab *document,
+                          QString *errorMessage)
+{
+    stop();
+    
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    out.setDevice(&file);
+    out.setRealNumberPrecision(12);
+    
+    out << TRACE_HEADER << '\n';
+    out << "window " << window->width() << ' ' << window->height() << '\n';
+    
+    const CircuitCanvas *view = document->canvas();
+    const QTransform t = view->transform();
+    out << "view " << t.m11() << ' ' << t.m12() << ' ' << t.m21() << ' ' << t.m22() << ' '
+        << view->horizontalScrollBar()->value() << ' '
+        << view->verticalScrollBar()->value() << '\n';
+    
+    for (const QString &line : document->editor()->toPlainText().split('\n')) {
+        out << "code " << line << '\n';
+    }
+    
+    setDocument(document);
+    clock.start();
+    return true;
+}
+
+void InputRecorder::setDocument(DocumentTab *document)
+{
+    if (canvas) {
+        canvas->viewport()->removeEventFilter(this);
+    }
+    if (code) {
+        disconnect(code.data(), nullptr, this, nullptr);
+    }
+    
+    canvas = document ? document->canvas() : nullptr;
+    code = document ? document->editor()->document() : nullptr;
+    sync = document ? document->sync() : nullptr;
+    text = code ? code->toPlainText() : QString();
+    
+    if (canvas) {
+        canvas->viewport()->installEventFilter(this);
+    }
+    if (code) {
+        connect(code, &QTextDocument::contentsChange, this, &InputRecorder::onContentsChange);
+    }
+}
+
+void InputRecorder::stop()
+{
+    setDocument(nullptr);
+    
+    if (file.isOpen()) {
+        out.flush();
+        out.setDevice(nullptr);
+        file.close();
+    }
+}
+
+void InputRecorder::recordTool(ElementType type)
+{
+    writeEntry("tool", { QString::number(int(type)) });
+}
+
+void InputRecorder::recordImport(const QString &fileName)
+{
+    writeEntry("import", { encodeText(fileName) });
+}
+
+void InputRecorder::recordMerge(const QString &baseName, const QString &theirName)
+{
+    writeEntry("merge", { encodeText(baseName), encodeText(theirName) });
+}
+
+void InputRecorder::recordQuery(const QString &query, bool zoom)
+{
+    writeEntry("query", { QString::number(int(zoom)), encodeText(query) });
+}
+
+void InputRecorder::recordHighDensity(bool enabled)
+{
+    writeEntry("density", { QString::number(int(enabled)) });
+}
+
+void InputRecorder::writeEntry(const char *kind, const QStringList &fields)
+{
+    if (!isRecording()) {
+        return;
+    }
+    out << kind << ' ' << clock.elapsed();
+    for (const QString &field : fields) {
+        out << ' ' << field;
+    }
+    out << '\n';
+}
+
+QString InputRecorder::encodeText(const QString &text)
+{
+    return QLatin1Char('=') + QString::fromLatin1(text.toUtf8().toPercentEncoding());
+}
+
+bool InputRecorder::decodeText(const QString &field, QString *text)
+{
+    if (!field.startsWith(QLatin1Char('='))) {
+        return false;
+    }
+    *text = QString::fromUtf8(QByteArray::fromPercentEncoding(field.mid(1).toLatin1()));
+    return true;
+}
+
+// Code edits are recorded as replacements of a range of the text. Edits
+// TikzSync makes itself follow from canvas input and are left out, the
+// replay repeats them on its own.
+void InputRecorder::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    // The document counts a final paragraph separator the plain text lacks
+    position = qBound(0, position, int(text.size()));
+    charsRemoved = qBound(0, charsRemoved, int(text.size()) - position);
+    
+    QTextCursor cursor(code);
+    cursor.setPosition(position);
+    cursor.setPosition(qMin(position + charsAdded, code->characterCount() - 1), QTextCursor::KeepAnchor);
+    QString added = cursor.selectedText();
+    added.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    
+    if (QStringView(text).mid(position, charsRemoved) == added) {
+        return;
+    }
+    text.replace(position, charsRemoved, added);
+    
+    if (sync && sync->isUpdatingText()) {
+        return;
+    }
+    writeEntry("edit", { QString::number(position), QString::number(charsRemoved), encodeText(added) });
+}
+
+// Only observes; every event continues to the canvas unchanged.
+bool InputRecorder::eventFilter(QObject *watched, QEvent *event)
+{
+    const char *kind = nullptr;
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:    kind = "press"; break;
+    case QEvent::MouseButtonRelease:  kind = "release"; break;
+    case QEvent::MouseButtonDblClick: kind = "dblclick"; break;
+    case QEvent::MouseMove:           kind = "move"; break;
+    case QEvent::Wheel:               kind = "wheel"; break;
+    default:
+        return QObject::eventFilter(watched, event);
+    }
+    
+    out << kind << ' ' << clock.elapsed() << ' ';
+    
+    if (event->type() == QEvent::Wheel) {
+        auto wheel = static_cast<QWheelEvent*>(event);
+        out << wheel->position().x() << ' ' << wheel->position().y() << ' '
+            << wheel->angleDelta().x() << ' ' << wheel->angleDelta().y() << ' '
+            << int(wheel->buttons()) << ' ' << int(wheel->modifiers()) << '\n';
+    } else {
+        auto mouse = static_cast<QMouseEvent*>(event);
+        out << mouse->position().x() << ' ' << mouse->position().y() << ' '
+            << int(mouse->button()) << ' ' << int(mouse->buttons()) << ' '
+            << int(mouse->modifiers()) << '\n';
+    }
+    
+    return QObject::eventFilter(watched, event);
+}
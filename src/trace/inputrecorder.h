@@ -0,0 +1,77 @@
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QStringList>
+#include "../circuit/circuitelement.h"
+
+class CircuitCanvas;
+class DocumentTab;
+class QMainWindow;
+class QTextDocument;
+class TikzSync;
+
+// Writes the mouse and wheel input reaching a canvas, the user's edits of
+// its TikZ code and the menu actions that change the circuit (tool choice,
+// netlist import, merge, query, high-density mode) to a line based trace
+// file that InputReplayer can play back. The trace starts with the window
+// geometry, view transform and document text so the replay begins from the
+// same state.
+//
+// Every entry is "<kind> <ms since start> <fields>"; text fields are
+// written as '=' followed by their percent-encoded UTF-8.
+class InputRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InputRecorder(QObject *parent = nullptr);
+    ~InputRecorder();
+
+    bool start(const QString &fileName, QMainWindow *window, DocumentTab *document,
+               QString *errorMessage);
+    void stop();
+    bool isRecording() const { return file.isOpen(); }
+    
+    // Follows the window to the document an import opened
+    void setDocument(DocumentTab *document);
+
+    void recordTool(ElementType type);
+    void recordImport(const QString &fileName);
+    void recordMerge(const QString &baseName, const QString &theirName);
+    void recordQuery(const QString &query, bool zoom);
+    void recordHighDensity(bool enabled);
+
+    static QString encodeText(const QString &text);
+    static bool decodeText(const QString &field, QString *text);
+
+    static constexpr const char *TRACE_HEADER = "# circuitikz-editor input trace 2";
+    // Version 1 traces hold canvas input and tool choices only
+    static constexpr const char *TRACE_HEADER_V1 = "# circuitikz-editor input trace 1";
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    void writeEntry(const char *kind, const QStringList &fields);
+
+    QPointer<CircuitCanvas> canvas;
+    QPointer<QTextDocument> code;
+    QPointer<TikzSync> sync;
+    // Text of the code document as last seen. Highlighting reports
+    // formatting changes as equal-length replacements; comparing against
+    // this copy keeps them out of the trace.
+    QString text;
+    QFile file;
+    QTextStream out;
+    QElapsedTimer clock;
+};
+
+#endif // INPUTRECORDER_H
@@ -0,0 +1,271 @@
+#include "inputreplayer.h"
+#include "inputrecorder.h"
+#include "../mainwindow.h"
+#include "../documenttab.h"
+#include "../circuit/circuitcanvas.h"
+#include "../editor/tikzcodeeditor.h"
+#include <QApplication>
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QThreadPool>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const char *const kindNames[] = {
+    "press", "release", "dblclick", "move", "wheel", "tool",
+    "edit", "import", "merge", "query", "density"
+};
+
+}
+
+InputReplayer::InputReplayer(MainWindow *window)
+    : window(window)
+    , windowSize(1200, 800)
+{
+}
+
+bool InputReplayer::load(const QString &fileName, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorMessage = file.errorString();
+        return false;
+    }
+    
+    QTextStream in(&file);
+    const QString header = in.readLine();
+    if (header != QLatin1String(InputRecorder::TRACE_HEADER)
+        && header != QLatin1String(InputRecorder::TRACE_HEADER_V1)) {
+        *errorMessage = "Not an input trace";
+        return false;
+    }
+    
+    QStringList codeLines;
+    events.clear();
+    
+    for (int lineNumber = 2; !in.atEnd(); ++lineNumber) {
+        const QString line = in.readLine();
+        if (line.startsWith(QLatin1String("code"))) {
+            codeLines.append(line.mid(5));
+            continue;
+        }
+        
+        const QStringList fields = line.split(' ', Qt::SkipEmptyParts);
+        if (fields.isEmpty() || fields.first().startsWith('#')) {
+            continue;
+        }
+        
+        const QString &keyword = fields.first();
+        bool ok = true;
+        auto number = [&](int index) {
+            bool valid = index < fields.size();
+            double value = valid ? fields.at(index).toDouble(&valid) : 0.0;
+            ok = ok && valid;
+            return value;
+        };
+        auto text = [&](int index) {
+            QString value;
+            ok = ok && index < fields.size() && InputRecorder::decodeText(fields.at(index), &value);
+            return value;
+        };
+        
+        if (keyword == QLatin1String("window")) {
+            windowSize = QSize(int(number(1)), int(number(2)));
+        } else if (keyword == QLatin1String("view")) {
+            viewTransform = QTransform(number(1), number(2), number(3), number(4), 0, 0);
+            viewScroll = QPoint(int(number(5)), int(number(6)));
+        } else {
+            const auto name = std::find_if(std::begin(kindNames), std::end(kindNames),
+                                           [&](const char *kind) { return keyword == QLatin1String(kind); });
+            if (name == std::end(kindNames)) {
+                *errorMessage = QString("Line %1: unknown entry '%2'").arg(lineNumber).arg(keyword);
+                return false;
+            }
+            
+            // Field 1 is the recording time, kept in the file for reference only
+            Event event = {};
+            event.kind = Kind(name - std::begin(kindNames));
+            switch (event.kind) {
+            case Kind::Tool:
+                event.tool = int(number(2));
+                break;
+            case Kind::Edit:
+                event.position = int(number(2));
+                event.removed = int(number(3));
+                event.text = text(4);
+                break;
+            case Kind::Import:
+                event.text = text(2);
+                break;
+            case Kind::Merge:
+                event.text = text(2);
+                event.secondText = text(3);
+                break;
+            case Kind::Query:
+                event.position = int(number(2));
+                event.text = text(3);
+                break;
+            case Kind::HighDensity:
+                event.position = int(number(2));
+                break;
+            case Kind::Wheel:
+                event.pos = QPointF(number(2), number(3));
+                event.angleDelta = QPoint(int(number(4)), int(number(5)));
+                event.buttons = int(number(6));
+                event.modifiers = int(number(7));
+                break;
+            default:
+                event.pos = QPointF(number(2), number(3));
+                event.button = int(number(4));
+                event.buttons = int(number(5));
+                event.modifiers = int(number(6));
+                break;
+            }
+            events.append(event);
+        }
+        
+        if (!ok) {
+            *errorMessage = QString("Line %1: malformed '%2' entry").arg(lineNumber).arg(keyword);
+            return false;
+        }
+    }
+    
+    code = codeLines.join('\n');
+    return true;
+}
+
+void InputReplayer::run()
+{
+    for (auto &list : latencies) {
+        list.clear();
+    }
+    
+    // Rebuild the recorded starting state in a fresh document
+    window->resize(windowSize);
+    window->show();
+    window->newCircuit();
+    
+    DocumentTab *document = window->currentDocument();
+    document->editor()->setPlainText(code);
+    QCoreApplication::processEvents();
+    
+    CircuitCanvas *canvas = document->canvas();
+    canvas->setTransform(viewTransform);
+    canvas->horizontalScrollBar()->setValue(viewScroll.x());
+    canvas->verticalScrollBar()->setValue(viewScroll.y());
+    QCoreApplication::processEvents();
+    
+    QElapsedTimer timer;
+    for (const Event &event : events) {
+        timer.start();
+        dispatch(event);
+        // Count background work, the repaint and the code update the event
+        // triggered as well
+        QThreadPool::globalInstance()->waitForDone();
+        QCoreApplication::sendPostedEvents();
+        QCoreApplication::processEvents();
+        latencies[int(event.kind)].append(timer.nsecsElapsed());
+    }
+    
+    for (auto &list : latencies) {
+        std::sort(list.begin(), list.end());
+    }
+}
+
+void InputReplayer::dispatch(const Event &event)
+{
+    DocumentTab *document = window->currentDocument();
+    CircuitCanvas *canvas = document->canvas();
+    QWidget *viewport = canvas->viewport();
+    const QPointF globalPos = viewport->mapToGlobal(event.pos);
+    
+    switch (event.kind) {
+    case Kind::Tool:
+        canvas->setActiveElementType(ElementType(event.tool));
+        break;
+    case Kind::Edit: {
+        QTextDocument *code = document->editor()->document();
+        const int end = code->characterCount() - 1;
+        QTextCursor cursor(code);
+        cursor.setPosition(qBound(0, event.position, end));
+        cursor.setPosition(qBound(0, event.position + event.removed, end), QTextCursor::KeepAnchor);
+        cursor.insertText(event.text);
+        break;
+    }
+    case Kind::Import:
+        window->importNetlistFile(event.text);
+        break;
+    case Kind::Merge:
+        window->mergeRevisionFiles(event.text, event.secondText);
+        break;
+    case Kind::Query:
+        window->runQuery(event.text, event.position != 0);
+        break;
+    case Kind::HighDensity:
+        window->setHighDensity(event.position != 0);
+        break;
+    case Kind::Wheel: {
+        QWheelEvent wheel(event.pos, globalPos, QPoint(), event.angleDelta,
+                          Qt::MouseButtons(event.buttons), Qt::KeyboardModifiers(event.modifiers),
+                          Qt::NoScrollPhase, false);
+        QApplication::sendEvent(viewport, &wheel);
+        break;
+    }
+    default: {
+        static const QEvent::Type types[] = {
+            QEvent::MouseButtonPress, QEvent::MouseButtonRelease,
+            QEvent::MouseButtonDblClick, QEvent::MouseMove
+        };
+        QMouseEvent mouse(types[int(event.kind)], event.pos, globalPos,
+                          Qt::MouseButton(event.button), Qt::MouseButtons(event.buttons),
+                          Qt::KeyboardModifiers(event.modifiers));
+        QApplication::sendEvent(viewport, &mouse);
+        break;
+    }
+    }
+}
+
+qint64 InputReplayer::percentile(const QList<qint64> &sorted, int percent)
+{
+    // Nearest rank
+    qsizetype rank = qsizetype(std::ceil(percent / 100.0 * sorted.size()));
+    return sorted.at(qBound<qsizetype>(0, rank - 1, sorted.size() - 1));
+}
+
+QString InputReplayer::report() const
+{
+    QString text = QString("%1 %2 %3 %4 %5 %6\n")
+        .arg("event", -10).arg("count", 8)
+        .arg("p50 us", 10).arg("p90 us", 10).arg("p99 us", 10).arg("max us", 10);
+    
+    QList<qint64> all;
+    auto appendRow = [&text](const QString &name, const QList<qint64> &sorted) {
+        text += QString("%1 %2 %3 %4 %5 %6\n")
+            .arg(name, -10).arg(sorted.size(), 8)
+            .arg(percentile(sorted, 50) / 1000.0, 10, 'f', 1)
+            .arg(percentile(sorted, 90) / 1000.0, 10, 'f', 1)
+            .arg(percentile(sorted, 99) / 1000.0, 10, 'f', 1)
+            .arg(sorted.last() / 1000.0, 10, 'f', 1);
+    };
+    
+    for (int kind = 0; kind < int(Kind::KindCount); ++kind) {
+        if (!latencies[kind].isEmpty()) {
+            appendRow(kindNames[kind], latencies[kind]);
+            all += latencies[kind];
+        }
+    }
+    
+    if (!all.isEmpty()) {
+        std::sort(all.begin(), all.end());
+        appendRow("all", all);
+    }
+    return text;
+}
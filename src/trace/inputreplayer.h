@@ -0,0 +1,60 @@
+#ifndef INPUTREPLAYER_H
+#define INPUTREPLAYER_H
+
+#include <QList>
+#include <QPointF>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <QTransform>
+
+class MainWindow;
+
+// Plays an InputRecorder trace back against a MainWindow, one event after
+// the other without the recorded pauses, and measures how long each event
+// takes until all work it posted, on the GUI thread or the thread pool,
+// has been processed. Code edits are applied to the code document and menu
+// actions are run without their dialogs. Meant to run with the offscreen
+// platform so a slow session can be profiled repeatedly.
+class InputReplayer
+{
+public:
+    explicit InputReplayer(MainWindow *window);
+
+    bool load(const QString &fileName, QString *errorMessage);
+    void run();
+    QString report() const;
+
+private:
+    enum class Kind {
+        Press, Release, DoubleClick, Move, Wheel, Tool,
+        Edit, Import, Merge, Query, HighDensity, KindCount
+    };
+
+    struct Event {
+        Kind kind;
+        QPointF pos;
+        QPoint angleDelta;
+        int button;
+        int buttons;
+        int modifiers;
+        int tool;
+        int position;       // edit range, or query zoom and high-density flag
+        int removed;
+        QString text;       // inserted text, file name or query
+        QString secondText; // merge: their revision
+    };
+
+    void dispatch(const Event &event);
+    static qint64 percentile(const QList<qint64> &sorted, int percent);
+
+    MainWindow *window;
+    QSize windowSize;
+    QTransform viewTransform;
+    QPoint viewScroll;
+    QString code;
+    QList<Event> events;
+    QList<qint64> latencies[int(Kind::KindCount)];
+};
+
+#endif // INPUTREPLAYER_H
@@ -0,0 +1,151 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QProcess>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include "../../src/circuit/circuitcanvas.h"
+
+// Compares high-density mode with one item per element for a synthetic
+// circuit: memory added by loading it and the time to paint the whole
+// circuit zoomed out. Each mode is measured in a fresh child process so
+// neither run inherits heap the other freed.
+//
+//     density-benchmark [count]
+//     density-benchmark --mode high-density|items <count>
+
+namespace {
+
+constexpr int RUNS = 5;
+
+// The request behind high-density mode asks for an order of magnitude
+constexpr double TARGET_RATIO = 10.0;
+
+// Resident set size from /proc, or -1 where that is not available
+qint64 residentKilobytes()
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return -1;
+    }
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+
+// Prints "<bytes per element> <median repaint ms>" for one mode; bytes are
+// -1 where resident memory cannot be read
+int measure(bool highDensity, int count)
+{
+    static constexpr ElementType TYPES[] = {
+        ElementType::Resistor, ElementType::Capacitor, ElementType::Inductor,
+        ElementType::VoltageSource, ElementType::CurrentSource, ElementType::Ground, ElementType::Node
+    };
+    
+    QList<ElementRecord> records;
+    records.reserve(count);
+    const int columns = qMax(1, int(std::sqrt(double(count))));
+    for (int i = 0; i < count; ++i) {
+        ElementRecord record;
+        record.type = TYPES[i % std::size(TYPES)];
+        record.pos = QPointF((i % columns) * 80.0, (i / columns) * 80.0);
+        record.label = QString("R_{%1}").arg(i);
+        records.append(record);
+    }
+    
+    CircuitCanvas canvas;
+    canvas.resize(1600, 1200);
+    canvas.setHighDensity(highDensity);
+    
+    const qint64 before = residentKilobytes();
+    canvas.importElements(records);
+    const qint64 after = residentKilobytes();
+    
+    canvas.fitInView(canvas.sceneRect(), Qt::KeepAspectRatio);
+    QImage image(canvas.size(), QImage::Format_RGB32);
+    QList<qint64> times;
+    for (int run = 0; run < RUNS; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        canvas.render(&image);
+        times.append(timer.nsecsElapsed());
+    }
+    std::sort(times.begin(), times.end());
+    
+    const double bytes = before >= 0 && after >= 0 ? (after - before) * 1024.0 / qMax(1, count) : -1.0;
+    QTextStream(stdout) << bytes << ' ' << times.at(RUNS / 2) / 1000000.0 << '\n';
+    return 0;
+}
+
+bool runChild(const QString &mode, int count, double *bytes, double *milliseconds)
+{
+    QProcess child;
+    child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    child.start(QCoreApplication::applicationFilePath(),
+                { QStringLiteral("--mode"), mode, QString::number(count) });
+    if (!child.waitForFinished(-1) || child.exitStatus() != QProcess::NormalExit || child.exitCode() != 0) {
+        return false;
+    }
+    
+    const QList<QByteArray> fields = child.readAllStandardOutput().trimmed().split(' ');
+    if (fields.size() != 2) {
+        return false;
+    }
+    *bytes = fields.at(0).toDouble();
+    *milliseconds = fields.at(1).toDouble();
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    
+    if (argc == 4 && std::strcmp(argv[1], "--mode") == 0) {
+        return measure(std::strcmp(argv[2], "high-density") == 0, std::atoi(argv[3]));
+    }
+    
+    const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    
+    double denseBytes = 0;
+    double denseTime = 0;
+    double itemBytes = 0;
+    double itemTime = 0;
+    if (!runChild(QStringLiteral("high-density"), count, &denseBytes, &denseTime)
+        || !runChild(QStringLiteral("items"), count, &itemBytes, &itemTime)) {
+        err << "Measurement process failed" << Qt::endl;
+        return 1;
+    }
+    
+    out << "elements: " << count << "\n";
+    out << "high-density: " << denseBytes << " bytes/element, full repaint " << denseTime << " ms (median)\n";
+    out << "items:        " << itemBytes << " bytes/element, full repaint " << itemTime << " ms (median)\n";
+    if (denseBytes <= 0 || itemBytes <= 0) {
+        out << "memory: resident set size not available\n";
+    } else {
+        // What remains per element in high-density mode is its index entry
+        // with the label string, its memberships in the type, label, cell
+        // and terminal sets, and its store record
+        const double ratio = itemBytes / denseBytes;
+        out << "memory:  " << ratio << "x less (target " << TARGET_RATIO << "x, "
+            << (ratio >= TARGET_RATIO ? "met" : "missed") << ")\n";
+    }
+    const double speedup = itemTime / qMax(1e-6, denseTime);
+    out << "repaint: " << speedup << "x faster (target " << TARGET_RATIO << "x, "
+        << (speedup >= TARGET_RATIO ? "met" : "missed") << ")\n";
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include <QElapsedTimer>
+#include <QList>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include "../../src/circuit/tikzgenerator.h"
+
+// Times TikZ generation for a synthetic circuit of all element types on a
+// grid, once with the QString::arg based generator the editor used to ship
+// and once with TikzGenerator, and checks that both produce the same text.
+//
+//     tikz-benchmark [count]
+
+namespace {
+
+constexpr int RUNS = 7;
+constexpr qreal GRID_TO_TIKZ_SCALE = 0.05;
+
+// The former generator, reading records instead of canvas items so both
+// run on the same snapshot
+QString formatCoordinate(qreal x, qreal y)
+{
+    return QString("(%1,%2)").arg(x, 0, 'f', 2).arg(y, 0, 'f', 2);
+}
+
+QString argElementCode(const ElementRecord &element)
+{
+    qreal x = element.pos.x() * GRID_TO_TIKZ_SCALE;
+    qreal y = -element.pos.y() * GRID_TO_TIKZ_SCALE;
+    
+    QString label = element.label;
+    if (label.isEmpty()) {
+        label = "?";
+    }
+    
+    switch (element.type) {
+        case ElementType::Resistor:
+            return QString("\\draw %1 to[R, l=$%2$] ++(2,0);").arg(formatCoordinate(x, y)).arg(label);
+        case ElementType::Capacitor:
+            return QString("\\draw %1 to[C, l=$%2$] ++(2,0);").arg(formatCoordinate(x, y)).arg(label);
+        case ElementType::Inductor:
+            return QString("\\draw %1 to[L, l=$%2$] ++(2,0);").arg(formatCoordinate(x, y)).arg(label);
+        case ElementType::VoltageSource:
+            return QString("\\draw %1 to[V, l=$%2$] ++(0,-2);").arg(formatCoordinate(x, y)).arg(label);
+        case ElementType::CurrentSource:
+            return QString("\\draw %1 to[I, l=$%2$] ++(0,-2);").arg(formatCoordinate(x, y)).arg(label);
+        case ElementType::Ground:
+            return QString("\\node[ground] at %1 {};").arg(formatCoordinate(x, y));
+        case ElementType::Node:
+            return QString("\\node[circ] at %1 {};").arg(formatCoordinate(x, y));
+    }
+    return QString();
+}
+
+QString argGenerate(const CircuitSnapshot &snapshot)
+{
+    QString tikzCode;
+    QTextStream stream(&tikzCode);
+    
+    stream << "\\begin{circuitikz}[scale=1.0]\n" << "\n";
+    
+    if (snapshot.isEmpty()) {
+        stream << "% No elements in circuit\n";
+    } else {
+        stream << "% Circuit elements\n";
+        
+        QList<const ElementRecord*> resistors, capacitors, inductors, sources, nodes, grounds;
+        snapshot.forEach([&](const ElementRecord &element) {
+            switch (element.type) {
+                case ElementType::Resistor:
+                    resistors.append(&element);
+                    break;
+                case ElementType::Capacitor:
+                    capacitors.append(&element);
+                    break;
+                case ElementType::Inductor:
+                    inductors.append(&element);
+                    break;
+                case ElementType::VoltageSource:
+                case ElementType::CurrentSource:
+                    sources.append(&element);
+                    break;
+                case ElementType::Node:
+                    nodes.append(&element);
+                    break;
+                case ElementType::Ground:
+                    grounds.append(&element);
+                    break;
+            }
+        });
+        
+        const std::pair<const char*, const QList<const ElementRecord*>*> sections[] = {
+            { "% Resistors\n", &resistors },
+            { "% Capacitors\n", &capacitors },
+            { "% Inductors\n", &inductors },
+            { "% Sources\n", &sources },
+            { "% Nodes\n", &nodes },
+            { "% Ground connections\n", &grounds },
+        };
+        for (const auto &section : sections) {
+            if (section.second->isEmpty()) {
+                continue;
+            }
+            stream << section.first;
+            for (auto element : *section.second) {
+                stream << argElementCode(*element) << "\n";
+            }
+            stream << "\n";
+        }
+        
+        if (snapshot.size() > 1) {
+            stream << "% Example connections (manually adjust as needed)\n";
+            stream << "% \\draw (0,0) to[R, l=$R_1$] (2,0) to[C, l=$C_1$] (4,0);\n";
+        }
+    }
+    
+    stream << "\\end{circuitikz}";
+    stream.flush();
+    return tikzCode;
+}
+
+// Sorted run times in nanoseconds; output receives the last result
+template <typename Function>
+QList<qint64> time(Function generate, QString *output)
+{
+    QList<qint64> times;
+    for (int run = 0; run < RUNS; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        *output = generate();
+        times.append(timer.nsecsElapsed());
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    static constexpr ElementType TYPES[] = {
+        ElementType::Resistor, ElementType::Capacitor, ElementType::Inductor,
+        ElementType::VoltageSource, ElementType::CurrentSource, ElementType::Ground, ElementType::Node
+    };
+    
+    const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    
+    ElementStore store;
+    const int columns = qMax(1, int(std::sqrt(double(count))));
+    for (int i = 0; i < count; ++i) {
+        ElementRecord record;
+        record.id = quint64(i) + 1;
+        record.type = TYPES[i % std::size(TYPES)];
+        // No coordinate is zero, where QString::arg writes a negative zero
+        record.pos = QPointF((i % columns) * 80.0 - 4020.0, (i / columns) * 80.0 - 4020.0);
+        record.label = QString("R_{%1}").arg(i);
+        store.insert(record);
+    }
+    const CircuitSnapshot snapshot = store.snapshot();
+    
+    TikzGenerator generator;
+    QList<quint64> lineElementIds;
+    QString before;
+    QString after;
+    QString withLines;
+    const QList<qint64> argTimes = time([&]() { return argGenerate(snapshot); }, &before);
+    const QList<qint64> generatorTimes = time([&]() { return generator.generateFromSnapshot(snapshot); }, &after);
+    // The code view also asks for the element id of every line
+    const QList<qint64> lineTimes = time([&]() {
+        return generator.generateFromSnapshot(snapshot, &lineElementIds);
+    }, &withLines);
+    
+    QTextStream out(stdout);
+    out << "elements: " << count << ", output: " << after.size() << " characters\n";
+    
+    auto report = [&out, count](const char *name, const QList<qint64> &times) {
+        out << name << "best " << times.first() / 1000000.0 << " ms, median "
+            << times.at(RUNS / 2) / 1000000.0 << " ms, "
+            << double(times.at(RUNS / 2)) / qMax(1, count) << " ns/line\n";
+    };
+    report("QString::arg:          ", argTimes);
+    report("TikzGenerator:         ", generatorTimes);
+    report("TikzGenerator + lines: ", lineTimes);
+    out << "speedup (median):      " << double(argTimes.at(RUNS / 2)) / qMax<qint64>(1, generatorTimes.at(RUNS / 2))
+        << "x\n";
+    
+    if (before != after || after != withLines) {
+        out << "outputs differ\n";
+        return 1;
+    }
+    return 0;
+}
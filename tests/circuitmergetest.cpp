@@ -0,0 +1,102 @@
+#include <QtTest>
+#include "../src/diff/circuitdiff.h"
+
+namespace {
+
+ElementRecord record(ElementType type, qreal x, qreal y, const QString &label)
+{
+    ElementRecord element;
+    element.type = type;
+    element.pos = QPointF(x, y);
+    element.label = label;
+    return element;
+}
+
+}
+
+class CircuitMergeTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void relabelIsNotAMove();
+    void differingRelabelsConflict();
+    void matchingRelabelsMerge();
+    void moveAndRelabelCombine();
+};
+
+void CircuitMergeTest::relabelIsNotAMove()
+{
+    const QList<ElementRecord> before = { record(ElementType::Resistor, 0, 0, "R_1") };
+    const QList<ElementRecord> after = { record(ElementType::Resistor, 0, 0, "R_2") };
+    
+    CircuitDiff diff = CircuitDiff::compare(before, after);
+    QVERIFY(diff.added.isEmpty());
+    QVERIFY(diff.removed.isEmpty());
+    QVERIFY(diff.moved.isEmpty());
+    QCOMPARE(diff.relabeled.size(), 1);
+    QCOMPARE(diff.relabeled.first().to.label, QString("R_2"));
+}
+
+void CircuitMergeTest::differingRelabelsConflict()
+{
+    const QList<ElementRecord> base = {
+        record(ElementType::Resistor, 0, 0, "R_1"),
+        record(ElementType::Capacitor, 100, 0, "C_1"),
+    };
+    const QList<ElementRecord> ours = {
+        record(ElementType::Resistor, 0, 0, "R_a"),
+        record(ElementType::Capacitor, 100, 0, "C_1"),
+    };
+    const QList<ElementRecord> theirs = {
+        record(ElementType::Resistor, 0, 0, "R_b"),
+        record(ElementType::Capacitor, 100, 0, "C_1"),
+    };
+    
+    CircuitMerge merge = CircuitMerge::merge(base, ours, theirs);
+    QCOMPARE(merge.conflicts.size(), 1);
+    QCOMPARE(merge.conflicts.first().base.label, QString("R_1"));
+    QCOMPARE(merge.conflicts.first().ours.label, QString("R_a"));
+    QCOMPARE(merge.conflicts.first().theirs.label, QString("R_b"));
+    QVERIFY(!merge.conflicts.first().removedInOurs);
+    QVERIFY(!merge.conflicts.first().removedInTheirs);
+    
+    // One record for the base element, with our label
+    QCOMPARE(merge.result.size(), 2);
+    int resistors = 0;
+    for (const ElementRecord &element : merge.result) {
+        if (element.type == ElementType::Resistor) {
+            ++resistors;
+            QCOMPARE(element.label, QString("R_a"));
+        }
+    }
+    QCOMPARE(resistors, 1);
+}
+
+void CircuitMergeTest::matchingRelabelsMerge()
+{
+    const QList<ElementRecord> base = { record(ElementType::Inductor, 0, 0, "L_1") };
+    const QList<ElementRecord> ours = { record(ElementType::Inductor, 0, 0, "L_2") };
+    const QList<ElementRecord> theirs = { record(ElementType::Inductor, 0, 0, "L_2") };
+    
+    CircuitMerge merge = CircuitMerge::merge(base, ours, theirs);
+    QVERIFY(merge.conflicts.isEmpty());
+    QCOMPARE(merge.result.size(), 1);
+    QCOMPARE(merge.result.first().label, QString("L_2"));
+}
+
+void CircuitMergeTest::moveAndRelabelCombine()
+{
+    const QList<ElementRecord> base = { record(ElementType::Resistor, 0, 0, "R_1") };
+    const QList<ElementRecord> ours = { record(ElementType::Resistor, 200, 40, "R_1") };
+    const QList<ElementRecord> theirs = { record(ElementType::Resistor, 0, 0, "R_9") };
+    
+    CircuitMerge merge = CircuitMerge::merge(base, ours, theirs);
+    QVERIFY(merge.conflicts.isEmpty());
+    QCOMPARE(merge.result.size(), 1);
+    QCOMPARE(merge.result.first().pos, QPointF(200, 40));
+    QCOMPARE(merge.result.first().label, QString("R_9"));
+}
+
+QTEST_APPLESS_MAIN(CircuitMergeTest)
+#include "circuitmergetest.moc"